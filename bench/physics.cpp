@@ -0,0 +1,509 @@
+// Headless physics benchmark, builds without GL or GLFW so it can run on machines without a GPU.
+// Builds reproducible scenes from a seed, steps them and prints the step timings as JSON.
+// The swarm scene is also run through an ecs::World, and checked against the Object path.
+// Exits with 1 if the contact solver fails its checks, which run before the scenes.
+//
+// bench_physics [--scene random|pile|asteroids|corridor|swarm|all] [--bodies N] [--steps N] [--warmup N] [--seed N] [--threads N]
+
+#include "collider.h"
+#include "rigidbody2d.h"
+#include "object2d.h"
+#include "deterministicMath.h"
+#include "ecs/world.h"
+#include "ecs/components.h"
+#include "ecs/systems.h"
+
+#include "json/json.h"
+#include "glm/glm.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <iostream>
+
+struct BenchOptions {
+	std::string scene = "all";
+	unsigned bodies = 500;
+	unsigned steps = 600;
+	unsigned warmup = 60; // Steps run before timing starts, so caches and sleeping have settled in
+	unsigned seed = 1;
+	int threads = -1; // Narrowphase threads, -1 keeps the default
+};
+
+// mt19937 is specified exactly, unlike the standard distributions, so scenes match across toolchains
+class BenchRandom {
+public:
+	BenchRandom(unsigned seed) : engine(seed) {}
+
+	float uniform(float min, float max) {
+		return min + (max - min) * (float)(engine() / 4294967296.0);
+	}
+
+	unsigned below(unsigned count) {
+		return engine() % count;
+	}
+
+private:
+	std::mt19937 engine;
+};
+
+// Static boxes, tested against everything the broadphase moves
+class BenchWalls : public StaticColliderSource {
+public:
+	void add(glm::vec2 center, glm::vec2 half_size) {
+		auto wall = makeObj<MeshCollider>("wall", std::vector<glm::vec2>{
+			-half_size, glm::vec2(half_size.x, -half_size.y), half_size, glm::vec2(-half_size.x, half_size.y)
+		}, true);
+		wall->setPos(center);
+		wall->updateTransform();
+		wall->updateBounds();
+		walls.push_back(std::move(wall));
+	}
+
+	void queryStatic(const BoundingBox& region, std::vector<Collider*>& result) override {
+		for(auto& wall : walls) {
+			if(wall->bounding_box.intersects(region))
+				result.push_back(wall.get());
+		}
+	}
+
+	unsigned size() const { return walls.size(); }
+
+private:
+	std::vector<ObjPtr<MeshCollider>> walls;
+};
+
+struct BenchScene {
+	std::string name;
+	std::vector<ObjPtr<Object2d>> objects;
+	BenchWalls walls;
+	glm::vec2 gravity = glm::vec2(0);
+	bool compare_ecs = false; // Nothing in the scene touches, so an ecs::World can run it too
+	std::vector<float> radii; // Of the circle each body's shape was built around, the ecs copy uses circles
+
+	Rigidbody2d& addBody(glm::vec2 position, std::vector<glm::vec2> shape, float mass) {
+		objects.push_back(makeObj<Object2d>(std::string("body")));
+		Object2d& object = *objects.back();
+		object.setPos(position);
+		object.take(newObj<Rigidbody2d>("rigidbody", shape, mass));
+		return object.get<Rigidbody2d>("rigidbody");
+	}
+
+	Rigidbody2d& body(unsigned i) {
+		return objects[i]->get<Rigidbody2d>("rigidbody");
+	}
+
+	// Four walls around a square of the given half size
+	void addArena(float half_size) {
+		walls.add(glm::vec2(0, -half_size - 1), glm::vec2(half_size + 2, 1));
+		walls.add(glm::vec2(0, half_size + 1), glm::vec2(half_size + 2, 1));
+		walls.add(glm::vec2(-half_size - 1, 0), glm::vec2(1, half_size + 2));
+		walls.add(glm::vec2(half_size + 1, 0), glm::vec2(1, half_size + 2));
+	}
+};
+
+// A convex polygon with 3 to 8 vertices around a circle of the given radius
+static std::vector<glm::vec2> randomConvex(BenchRandom& random, float radius) {
+	unsigned count = 3 + random.below(6);
+	std::vector<float> angles;
+	for(unsigned i = 0; i < count; i++)
+		angles.push_back(random.uniform(0, glm::two_pi<float>()));
+	std::sort(angles.begin(), angles.end());
+
+	std::vector<glm::vec2> points;
+	for(float angle : angles)
+		points.emplace_back(glm::vec2(cos(angle), sin(angle)) * radius);
+	return points;
+}
+
+static std::vector<glm::vec2> box(glm::vec2 half_size) {
+	return { -half_size, glm::vec2(half_size.x, -half_size.y), half_size, glm::vec2(-half_size.x, half_size.y) };
+}
+
+// Random convex bodies bouncing around a closed arena, no gravity
+static void buildRandom(BenchScene& scene, unsigned count, BenchRandom& random) {
+	float half_size = sqrt((float)count) * 1.5f;
+	scene.addArena(half_size);
+
+	for(unsigned i = 0; i < count; i++) {
+		float radius = random.uniform(0.3f, 0.8f);
+		glm::vec2 position(random.uniform(-half_size + 1, half_size - 1), random.uniform(-half_size + 1, half_size - 1));
+		Rigidbody2d& body = scene.addBody(position, randomConvex(random, radius), radius * radius * 3);
+		body.setVelocity(glm::vec2(random.uniform(-4, 4), random.uniform(-4, 4)));
+		body.setAngularVelocity(random.uniform(-90, 90));
+	}
+}
+
+// Short columns of boxes dropped onto a floor, most of the cost is in resting contacts and sleeping. The columns are
+// far enough apart that each one settles and sleeps on its own, about 90% of the bodies are asleep by the end of the
+// default warmup. Taller or closer columns sway into each other and keep the whole floor awake
+static void buildPile(BenchScene& scene, unsigned count, BenchRandom& random) {
+	unsigned height = 5;
+	unsigned columns = std::max(1u, count / height);
+	float spacing = 2;
+	float width = columns * spacing;
+	scene.gravity = glm::vec2(0, -9.8f);
+	scene.walls.add(glm::vec2(0, -1), glm::vec2(width / 2 + 2, 1));
+
+	for(unsigned i = 0; i < count; i++) {
+		unsigned column = i % columns;
+		unsigned row = i / columns;
+		glm::vec2 position(-width / 2 + column * spacing + random.uniform(-0.05f, 0.05f), 0.5f + row * 1.05f);
+		scene.addBody(position, box(glm::vec2(0.5f)), 1);
+	}
+}
+
+// Rocks of every size packed close together and drifting, lots of overlapping boxes per body
+static void buildAsteroids(BenchScene& scene, unsigned count, BenchRandom& random) {
+	float half_size = sqrt((float)count) * 0.9f;
+	scene.addArena(half_size + 2);
+
+	for(unsigned i = 0; i < count; i++) {
+		float radius = random.uniform(0.2f, 0.2f + 1.2f * powf(random.uniform(0, 1), 3)); // Mostly small, a few large
+		glm::vec2 position(random.uniform(-half_size, half_size), random.uniform(-half_size, half_size));
+		Rigidbody2d& body = scene.addBody(position, randomConvex(random, radius), radius * radius * 3);
+		body.setVelocity(glm::vec2(random.uniform(-1, 1), random.uniform(-1, 1)));
+		body.setAngularVelocity(random.uniform(-30, 30));
+	}
+}
+
+// Fast bodies flying down a long corridor built from many wall segments, exercises the sweeps and static queries
+static void buildCorridor(BenchScene& scene, unsigned count, BenchRandom& random) {
+	float length = 400;
+	float half_width = 2 + sqrt((float)count) * 0.5f;
+	for(float x = -length / 2; x < length / 2; x += 2) {
+		scene.walls.add(glm::vec2(x + 1, -half_width - 0.25f), glm::vec2(1, 0.25f));
+		scene.walls.add(glm::vec2(x + 1, half_width + 0.25f), glm::vec2(1, 0.25f));
+	}
+	scene.walls.add(glm::vec2(-length / 2 - 0.25f, 0), glm::vec2(0.25f, half_width + 0.5f));
+	scene.walls.add(glm::vec2(length / 2 + 0.25f, 0), glm::vec2(0.25f, half_width + 0.5f));
+
+	for(unsigned i = 0; i < count; i++) {
+		float radius = random.uniform(0.2f, 0.4f);
+		glm::vec2 position(random.uniform(-length / 2 + 1, length / 2 - 1), random.uniform(-half_width + 0.5f, half_width - 0.5f));
+		Rigidbody2d& body = scene.addBody(position, randomConvex(random, radius), 1);
+		body.setFast(true);
+		body.setVelocity(glm::vec2(random.uniform(-60, 60), random.uniform(-20, 20)));
+	}
+}
+
+// A crowd of small bodies falling through each other, with collisions filtered out. What ecs::World is for
+static void buildSwarm(BenchScene& scene, unsigned count, BenchRandom& random) {
+	float half_size = sqrt((float)count) * 2;
+	scene.gravity = glm::vec2(0, -2);
+	scene.compare_ecs = true;
+
+	for(unsigned i = 0; i < count; i++) {
+		float radius = random.uniform(0.1f, 0.3f);
+		glm::vec2 position(random.uniform(-half_size, half_size), random.uniform(-half_size, half_size));
+		Rigidbody2d& body = scene.addBody(position, randomConvex(random, radius), radius * radius * 3);
+		scene.radii.push_back(radius);
+		body.collider->category = 0;
+		body.collider->mask = 0;
+		body.setVelocity(glm::vec2(random.uniform(-3, 3), random.uniform(-3, 3)));
+		body.setAngularVelocity(random.uniform(-90, 90));
+	}
+}
+
+static void buildScene(BenchScene& scene, const std::string& name, unsigned count, unsigned seed) {
+	BenchRandom random(seed);
+	scene.name = name;
+
+	if(name == "random")
+		buildRandom(scene, count, random);
+	else if(name == "pile")
+		buildPile(scene, count, random);
+	else if(name == "asteroids")
+		buildAsteroids(scene, count, random);
+	else if(name == "corridor")
+		buildCorridor(scene, count, random);
+	else if(name == "swarm")
+		buildSwarm(scene, count, random);
+}
+
+// Nearest rank percentiles of a list of microsecond timings
+static Json::Value summarize(std::vector<double> times) {
+	Json::Value result;
+	if(times.empty())
+		return result;
+
+	std::sort(times.begin(), times.end());
+	auto percentile = [&times](double p) {
+		unsigned rank = std::ceil(p / 100 * times.size());
+		return times[std::min<unsigned>(std::max(rank, 1u), times.size()) - 1];
+	};
+
+	double total = 0;
+	for(double time : times)
+		total += time;
+
+	result["mean"] = total / times.size();
+	result["min"] = times.front();
+	result["p50"] = percentile(50);
+	result["p90"] = percentile(90);
+	result["p99"] = percentile(99);
+	result["max"] = times.back();
+	return result;
+}
+
+// FNV-1a over the bits of every body's position, rotation and velocity. Deterministic builds should
+// print the same hash on every machine for the same seed and step count
+// In the order the scene's bodies were added, the store reorders them as they sleep and wake
+static std::string stateHash(BenchScene& scene) {
+	const BodyStore& store = Rigidbody2d::getStore();
+	uint64_t hash = 14695981039346656037ull;
+	for(const std::vector<float>* array : {&store.pos_x, &store.pos_y, &store.rot, &store.vel_x, &store.vel_y, &store.ang_vel}) {
+		for(unsigned i = 0; i < scene.objects.size(); i++) {
+			float value = (*array)[store.index(scene.body(i).getHandle())];
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			hash = (hash ^ bits) * 1099511628211ull;
+		}
+	}
+
+	char hex[17];
+	std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+	return hex;
+}
+
+// A copy of the scene's bodies in an ecs::World, one entity per body in the same order
+static std::vector<ecs::Entity> copyToWorld(BenchScene& scene, ecs::World& world) {
+	std::vector<ecs::Entity> entities;
+	for(unsigned i = 0; i < scene.objects.size(); i++) {
+		Object2d& object = *scene.objects[i];
+		Rigidbody2d& body = scene.body(i);
+
+		ecs::Entity e = world.create();
+		ecs::Transform transform;
+		transform.pos = object.getPos();
+		transform.rot = object.getRot();
+		world.add(e, transform);
+
+		ecs::Rigidbody rigidbody;
+		rigidbody.velocity = body.getVelocity();
+		rigidbody.angular_velocity = body.getAngularVelocity();
+		rigidbody.inv_mass = body.getInverseMass();
+		rigidbody.inv_moi = body.getInverseInertia();
+		world.add(e, rigidbody);
+
+		ecs::Collider collider;
+		collider.radius = scene.radii[i];
+		collider.category = body.collider->category;
+		collider.mask = body.collider->mask;
+		world.add(e, collider);
+
+		entities.push_back(e);
+	}
+	return entities;
+}
+
+// Steps the world like runScene() steps the objects. Returns the step timings, and the furthest any entity
+// ended up from its body
+static Json::Value runWorld(BenchScene& scene, ecs::World& world, const std::vector<ecs::Entity>& entities, const BenchOptions& options) {
+	typedef std::chrono::steady_clock clock;
+	const float deltaTime = 1 / 60.f;
+	const glm::vec2 gravity = scene.gravity;
+
+	std::vector<double> step_times;
+	for(unsigned step = 0; step < options.warmup + options.steps; step++) {
+		auto start = clock::now();
+		world.each<ecs::Rigidbody>([gravity](ecs::Rigidbody& body) {
+			if(body.inv_mass > 0)
+				body.force += gravity / body.inv_mass;
+		});
+		ecs::integrate(world, deltaTime);
+		ecs::updateTransforms(world);
+		ecs::updateBounds(world);
+		auto stepped = clock::now();
+
+		if(step >= options.warmup)
+			step_times.push_back(std::chrono::duration<double, std::micro>(stepped - start).count());
+	}
+
+	float max_error = 0;
+	for(unsigned i = 0; i < entities.size(); i++) {
+		const ecs::Transform& transform = *world.get<ecs::Transform>(entities[i]);
+		max_error = std::max(max_error, glm::length(transform.pos - scene.objects[i]->getPos()));
+	}
+
+	Json::Value result;
+	result["step_us"] = summarize(step_times);
+	result["max_position_error"] = max_error;
+	return result;
+}
+
+// Boxes with no elasticity hitting a floor at 1 unit per second, no gravity. Pushing them out of the floor
+// mustn't leave them moving away from it afterwards
+static Json::Value checkInelasticImpact() {
+	const float deltaTime = 1 / 60.f;
+	const unsigned count = 10;
+
+	BenchScene scene;
+	scene.walls.add(glm::vec2(0, -1), glm::vec2(count + 2, 1));
+	Collider::addStaticSource(&scene.walls);
+	for(unsigned i = 0; i < count; i++) {
+		Rigidbody2d& body = scene.addBody(glm::vec2(i * 2.f - count, 0.6f + i * 0.1f), box(glm::vec2(0.5f)), 1);
+		body.setVelocity(glm::vec2(0, -1));
+	}
+
+	// Every box has landed by step 60
+	float max_separating = 0;
+	for(unsigned step = 0; step < 180; step++) {
+		Rigidbody2d::updateAll(deltaTime);
+		Collider::checkAll(deltaTime);
+		for(unsigned i = 0; step >= 60 && i < count; i++)
+			max_separating = std::max(max_separating, scene.body(i).getVelocity().y);
+	}
+	Collider::removeStaticSource(&scene.walls);
+
+	Json::Value result;
+	result["max_separating_velocity"] = max_separating;
+	result["passed"] = max_separating < 0.01f;
+	return result;
+}
+
+static Json::Value runScene(const std::string& name, const BenchOptions& options) {
+	typedef std::chrono::steady_clock clock;
+	const float deltaTime = 1 / 60.f;
+
+	BenchScene scene;
+	buildScene(scene, name, options.bodies, options.seed);
+	Collider::addStaticSource(&scene.walls);
+
+	// Copied before anything moves
+	ecs::World world;
+	std::vector<ecs::Entity> entities;
+	if(scene.compare_ecs)
+		entities = copyToWorld(scene, world);
+
+	std::vector<double> update_times, check_times, step_times;
+	double pairs_tested = 0, pairs_colliding = 0, bodies_awake = 0;
+	unsigned awake_after_warmup = 0;
+
+	for(unsigned step = 0; step < options.warmup + options.steps; step++) {
+		if(scene.gravity != glm::vec2(0)) {
+			for(unsigned i = 0; i < scene.objects.size(); i++) {
+				Rigidbody2d& body = scene.body(i);
+				if(body.isAwake())
+					body.applyForce(scene.gravity * body.getMass());
+			}
+		}
+
+		auto start = clock::now();
+		Rigidbody2d::updateAll(deltaTime);
+		auto updated = clock::now();
+		Collider::checkAll(deltaTime);
+		auto checked = clock::now();
+
+		if(step < options.warmup)
+			continue;
+		if(step == options.warmup)
+			awake_after_warmup = Rigidbody2d::getStore().awakeCount();
+
+		update_times.push_back(std::chrono::duration<double, std::micro>(updated - start).count());
+		check_times.push_back(std::chrono::duration<double, std::micro>(checked - updated).count());
+		step_times.push_back(std::chrono::duration<double, std::micro>(checked - start).count());
+
+		pairs_tested += Collider::stats.pairs_tested;
+		pairs_colliding += Collider::stats.pairs_colliding;
+		const BodyStore& store = Rigidbody2d::getStore();
+		bodies_awake += store.awakeCount();
+	}
+
+	std::string hash = stateHash(scene);
+	Collider::removeStaticSource(&scene.walls);
+
+	Json::Value result;
+	result["scene"] = name;
+	result["bodies"] = (unsigned)scene.objects.size();
+	result["walls"] = scene.walls.size();
+	result["steps"] = options.steps;
+	result["update_all_us"] = summarize(update_times);
+	result["check_all_us"] = summarize(check_times);
+	result["step_us"] = summarize(step_times);
+	result["state_hash"] = hash;
+	result["deterministic"] = dmath::deterministic;
+	if(options.steps > 0) {
+		result["mean_pairs_tested"] = pairs_tested / options.steps;
+		result["mean_pairs_colliding"] = pairs_colliding / options.steps;
+		result["mean_bodies_awake"] = bodies_awake / options.steps;
+		result["bodies_awake_after_warmup"] = awake_after_warmup;
+	}
+	if(scene.compare_ecs)
+		result["ecs"] = runWorld(scene, world, entities, options);
+	return result;
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions* options) {
+	for(int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if(i + 1 >= argc) {
+			std::cerr << "Missing a value for " << arg << "\n";
+			return false;
+		}
+		std::string value = argv[++i];
+
+		if(arg == "--scene")
+			options->scene = value;
+		else if(arg == "--bodies")
+			options->bodies = std::stoul(value);
+		else if(arg == "--steps")
+			options->steps = std::stoul(value);
+		else if(arg == "--warmup")
+			options->warmup = std::stoul(value);
+		else if(arg == "--seed")
+			options->seed = std::stoul(value);
+		else if(arg == "--threads")
+			options->threads = std::stoi(value);
+		else {
+			std::cerr << "Unknown option " << arg << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv) {
+	BenchOptions options;
+	if(!parseOptions(argc, argv, &options))
+		return 1;
+
+	std::vector<std::string> scenes = {"random", "pile", "asteroids", "corridor", "swarm"};
+	if(options.scene != "all") {
+		if(std::find(scenes.begin(), scenes.end(), options.scene) == scenes.end()) {
+			std::cerr << "Unknown scene " << options.scene << "\n";
+			return 1;
+		}
+		scenes = {options.scene};
+	}
+
+	if(options.threads >= 0)
+		Collider::setNarrowphaseThreads(options.threads);
+
+	Json::Value output;
+	output["seed"] = options.seed;
+	output["warmup"] = options.warmup;
+	output["threads"] = options.threads;
+	output["checks"]["inelastic_impact"] = checkInelasticImpact();
+	for(const std::string& scene : scenes)
+		output["scenes"].append(runScene(scene, options));
+
+	Json::StreamWriterBuilder writer;
+	writer["indentation"] = "\t";
+	writer["precision"] = 6;
+	std::cout << Json::writeString(writer, output) << std::endl;
+
+	for(const std::string& check : output["checks"].getMemberNames()) {
+		if(!output["checks"][check]["passed"].asBool()) {
+			std::cerr << "Check failed: " << check << "\n";
+			return 1;
+		}
+	}
+	return 0;
+}
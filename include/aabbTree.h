@@ -0,0 +1,141 @@
+#pragma once
+
+#include "collider.h"
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+// A dynamic bounding volume tree. Each leaf holds a collider's bounding box, fattened
+// by a margin so that small movements don't require the leaf to be reinserted.
+// Inner nodes hold the union of their children, and the tree is kept balanced with
+// rotations as leaves are inserted and removed
+class AABBTree {
+public:
+	AABBTree(float margin = 0.1f);
+
+	float margin; // How much to fatten the leaf boxes by on each side
+	static constexpr float displacement_multiplier = 2.f; // How far ahead to extend a moving box, in multiples of its last displacement
+
+	int createProxy(const BoundingBox& box, Collider* collider); // Inserts a leaf and returns its id
+	void destroyProxy(int proxy);
+	bool moveProxy(int proxy, const BoundingBox& box, glm::vec2 displacement); // Returns true if the leaf had to be reinserted
+
+	Collider* getCollider(int proxy) const;
+	const BoundingBox& getFatBox(int proxy) const;
+	int getHeight() const;
+	unsigned getProxyCount() const;
+
+	// Calls callback(proxy) for each leaf whose fat box overlaps box, stops early if the callback returns false
+	template<typename F>
+	void query(const BoundingBox& box, F callback) const;
+
+	// Calls callback(proxy, max_fraction) for each leaf whose fat box is crossed by the segment from origin to
+	// origin + direction * max_distance. The callback returns the new max fraction to clip the segment to,
+	// 0 to stop, or a negative value to leave it unchanged
+	template<typename F>
+	void raycast(glm::vec2 origin, glm::vec2 direction, float max_distance, F callback) const;
+
+private:
+	struct Node {
+		BoundingBox box;
+		Collider* collider = nullptr;
+
+		int parent = -1; // Doubles as the next free node while the node is unused
+		int child1 = -1;
+		int child2 = -1;
+		int height = -1; // Leaves are 0, free nodes are -1
+
+		bool isLeaf() const { return child1 == -1; }
+	};
+
+	std::vector<Node> nodes;
+	int root = -1;
+	int free_list = -1;
+	unsigned proxy_count = 0;
+
+	static constexpr unsigned stack_size = 256; // Traversal stack, enough for any tree that stays balanced
+
+	int allocateNode();
+	void freeNode(int node);
+
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	int balance(int node);
+};
+
+template<typename F>
+void AABBTree::query(const BoundingBox& box, F callback) const {
+	if(root == -1)
+		return;
+
+	int stack[stack_size];
+	unsigned count = 0;
+	stack[count++] = root;
+
+	while(count > 0) {
+		int id = stack[--count];
+		const Node& node = nodes[id];
+		if(!node.box.intersects(box))
+			continue;
+
+		if(node.isLeaf()) {
+			if(!callback(id))
+				return;
+		} else if(count + 2 <= stack_size) {
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+		} else {
+			log("AABBTree query overflowed its stack, the tree is badly unbalanced", ERR);
+		}
+	}
+}
+
+template<typename F>
+void AABBTree::raycast(glm::vec2 origin, glm::vec2 direction, float max_distance, F callback) const {
+	if(root == -1 || direction == glm::vec2(0))
+		return;
+
+	glm::vec2 dir = glm::normalize(direction);
+	glm::vec2 perp(-dir.y, dir.x); // Separating axis for the segment
+	glm::vec2 abs_perp(std::abs(perp.x), std::abs(perp.y));
+
+	float max_fraction = 1;
+	glm::vec2 end = origin + dir * max_distance;
+	BoundingBox segment_box(glm::min(origin, end), glm::max(origin, end));
+
+	int stack[stack_size];
+	unsigned count = 0;
+	stack[count++] = root;
+
+	while(count > 0) {
+		int id = stack[--count];
+		const Node& node = nodes[id];
+		if(!node.box.intersects(segment_box))
+			continue;
+
+		// Skip the box if the segment's line misses it entirely
+		glm::vec2 center = node.box.getCenter();
+		glm::vec2 extents = node.box.getExtents();
+		if(std::abs(glm::dot(perp, origin - center)) > glm::dot(abs_perp, extents))
+			continue;
+
+		if(node.isLeaf()) {
+			float value = callback(id, max_fraction);
+			if(value == 0)
+				return;
+
+			if(value > 0 && value < max_fraction) {
+				// Clip the segment so farther boxes get culled
+				max_fraction = value;
+				end = origin + dir * (max_distance * max_fraction);
+				segment_box = BoundingBox(glm::min(origin, end), glm::max(origin, end));
+			}
+		} else if(count + 2 <= stack_size) {
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+		} else {
+			log("AABBTree raycast overflowed its stack, the tree is badly unbalanced", ERR);
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+class Rigidbody2d;
+
+// Rigidbody state packed into one array per field, so integration can run down them in SIMD registers.
+// Bodies hold a handle to their entry, entries get moved around when bodies are removed, sleep or wake.
+// Awake bodies are kept at the front, so the per step passes only run over them
+class BodyStore {
+public:
+	typedef unsigned Handle;
+
+	Handle add(Rigidbody2d* owner);
+	void remove(Handle handle);
+
+	unsigned index(Handle handle) const { return handle_to_index[handle]; }
+	unsigned size() const { return owners.size(); }
+	unsigned awakeCount() const { return awake_count; } // Entries before this are awake, the rest are asleep
+	bool isAwake(Handle handle) const { return handle_to_index[handle] < awake_count; }
+	void setAwake(Handle handle, bool awake); // Moves the entry across the boundary, changing its index
+
+	// Indexed by index(handle)
+	std::vector<float> pos_x, pos_y, rot; // The position and rotation (degrees) of the body's object, as of the last step
+	std::vector<float> vel_x, vel_y, ang_vel;
+	std::vector<float> force_x, force_y, torque; // Accumulated until the next step
+	std::vector<float> inv_mass, inv_moi;
+	std::vector<float> step_x, step_y, step_rot; // How far the last step moved each body
+	std::vector<float> sleep_time; // How long each body has been slow enough to sleep
+	std::vector<uint8_t> fast;
+	std::vector<Rigidbody2d*> owners;
+
+	// Velocities smaller than these are snapped to 0
+	static constexpr float rest_velocity = 0.01f;
+	static constexpr float rest_angular_velocity = 0.1f;
+
+	// Semi-implicit Euler for every awake body, fills in the step arrays and clears the forces
+	void integrate(float deltaTime, float sleep_velocity, float sleep_angular_velocity);
+
+private:
+	std::vector<unsigned> handle_to_index;
+	std::vector<Handle> index_to_handle;
+	std::vector<Handle> free_handles;
+	unsigned awake_count = 0;
+
+	void swapEntries(unsigned a, unsigned b);
+
+	template<typename F>
+	void forEachArray(F func); // Calls func on every float array
+};
@@ -38,5 +38,8 @@ public:
 	glm::mat4 getViewMatrix();
 	glm::mat4 getProjectionMatrix();
 	float getAspectRatio();
+
+private:
+	OBJECT_TYPE_ID(Camera2d);
 };
 
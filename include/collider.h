@@ -1,13 +1,19 @@
 #pragma once
 
 #include "logs.h"
-#include "mesh2d.h"
+#include "utility.h"
 #include "object2d.h"
+#include "workerPool.h"
 
 #include "glm/glm.hpp"
+#include "glm/gtc/constants.hpp"
 
 #include <vector>
+#include <array>
+#include <functional>
 #include <limits>
+#include <atomic>
+#include <unordered_map>
 
 // struct BoxNode {
 // 	BoxNode *prev, *next;
@@ -17,9 +23,6 @@
 
 struct BoundingBox {
 	BoundingBox() = default;
-	BoundingBox(Polygon& poly) {
-		setBounds(poly);
-	}
 	BoundingBox(glm::vec2 lower_left, glm::vec2 upper_right) :
 		lower_left(lower_left),
 		upper_right(upper_right)
@@ -29,28 +32,17 @@ struct BoundingBox {
 	glm::vec2 lower_left;
 	glm::vec2 upper_right;
 
-	void setBounds(std::vector<glm::vec2> points) {
-		Polygon::getPositionMinMax(
-			points, 
-			&lower_left.x,
-			&upper_right.x,
-			&lower_left.y,
-			&upper_right.y
-		);
-	}
-
-	void setBounds(Polygon& poly) {
-		Polygon::getPositionMinMax(
-			extractStructField(poly.vertices, &Vertex2d::pos), 
-			&lower_left.x,
-			&upper_right.x,
-			&lower_left.y,
-			&upper_right.y
-		);
+	void setBounds(const std::vector<glm::vec2>& points) {
+		lower_left = glm::vec2(std::numeric_limits<float>::max());
+		upper_right = glm::vec2(std::numeric_limits<float>::lowest());
+		for(glm::vec2 point : points) {
+			lower_left = glm::min(lower_left, point);
+			upper_right = glm::max(upper_right, point);
+		}
 	}
 
 	// Check to see if 2 bounding boxes intersect
-	bool intersects(const BoundingBox& b2) {
+	bool intersects(const BoundingBox& b2) const {
 		const BoundingBox& b1 = *this;
 
 		// glm::mat4 b1_transform = getWorldTransfrom();
@@ -72,30 +64,65 @@ struct BoundingBox {
 		}
 	}
 
+	// Check to see if this box completely encloses another
+	bool contains(const BoundingBox& b2) const {
+		return lower_left.x <= b2.lower_left.x && lower_left.y <= b2.lower_left.y &&
+		       upper_right.x >= b2.upper_right.x && upper_right.y >= b2.upper_right.y;
+	}
+
+	bool containsPoint(glm::vec2 point) const {
+		return point.x >= lower_left.x && point.x <= upper_right.x &&
+		       point.y >= lower_left.y && point.y <= upper_right.y;
+	}
+
+	glm::vec2 getCenter() const { return (lower_left + upper_right) / 2.f; }
+	glm::vec2 getExtents() const { return (upper_right - lower_left) / 2.f; }
+
+	// Used as the cost of a box when building trees, smaller is better
+	float getPerimeter() const {
+		return 2.f * ((upper_right.x - lower_left.x) + (upper_right.y - lower_left.y));
+	}
+
+	// Returns the smallest box that encloses both boxes
+	static BoundingBox merge(const BoundingBox& b1, const BoundingBox& b2) {
+		return BoundingBox(
+			glm::vec2(std::min(b1.lower_left.x, b2.lower_left.x), std::min(b1.lower_left.y, b2.lower_left.y)),
+			glm::vec2(std::max(b1.upper_right.x, b2.upper_right.x), std::max(b1.upper_right.y, b2.upper_right.y))
+		);
+	}
 };
 
 struct Simplex {
 public:
 	Simplex() : 
 		m_points({glm::vec2(0), glm::vec2(0), glm::vec2(0)}),
+		m_directions({glm::vec2(0), glm::vec2(0), glm::vec2(0)}),
 		m_size(0)
 	{}
 
-	Simplex& operator=(std::initializer_list<glm::vec2> list) {
-		for (auto v = list.begin(); v != list.end(); v++) {
-			m_points[std::distance(list.begin(), v)] = *v;
+	// Keeps only the points at these indices, in the order given
+	Simplex& keep(std::initializer_list<unsigned> indices) {
+		std::array<glm::vec2, 3> points = m_points, directions = m_directions;
+		unsigned i = 0;
+		for (unsigned index : indices) {
+			m_points[i] = points[index];
+			m_directions[i] = directions[index];
+			i++;
 		}
-		m_size = list.size();
+		m_size = indices.size();
 
 		return *this;
 	}
 
-	void push_front(glm::vec2 point) {
+	// Adds a support point, along with the direction that was used to find it
+	void push_front(glm::vec2 point, glm::vec2 direction = glm::vec2(0)) {
 		m_points = { point, m_points[0], m_points[1]};
+		m_directions = { direction, m_directions[0], m_directions[1]};
 		m_size = std::min(m_size + 1, 3u);
 	}
 
 	glm::vec2& operator[](unsigned i) { return m_points[i]; }
+	glm::vec2 direction(unsigned i) const { return m_directions[i]; }
 	unsigned size() const { return m_size; }
 
 	auto begin() const { return m_points.begin(); }
@@ -109,17 +136,94 @@ public:
 
 private:
 	std::array<glm::vec2, 3> m_points;
+	std::array<glm::vec2, 3> m_directions;
 	unsigned m_size;
 };
 
+// What GJK found for a pair of colliders on the last step they were tested, used to start the next test close to the answer
+struct GJKCache {
+	glm::vec2 direction = glm::vec2(1, 0); // The last search direction, a separating axis if the pair wasn't colliding
+	Simplex simplex; // The support directions of the final simplex
+	bool colliding = false;
+	unsigned last_step = 0;
+};
+
+class Collider;
+class AABBTree;
+class Rigidbody2d;
+
+typedef std::pair<Collider*, Collider*> ColliderPair;
+
+// Counters for the last call to Collider::checkAll
+struct CollisionStats {
+	unsigned colliders = 0; // Colliders in the broadphase
+	unsigned pairs_tested = 0; // Pairs whose bounding boxes overlapped and went to the narrowphase
+	unsigned pairs_colliding = 0; // Pairs the narrowphase found to be colliding
+	unsigned pairs_sleeping = 0; // Pairs skipped because neither collider could have moved
+	unsigned pairs_filtered = 0; // Overlapping pairs skipped because their categories and masks rule them out
+	unsigned proxies_moved = 0; // Tree leaves that left their fat box and had to be reinserted
+	unsigned transforms_changed = 0; // Colliders whose cached world vertices had to be rebuilt
+	int tree_height = 0;
+	unsigned gjk_iterations = 0; // Support points GJK needed past the warm start, over every pair
+	unsigned gjk_warm_exits = 0; // Pairs answered by the cached simplex or separating axis alone
+	unsigned epa_iterations = 0; // Polytope expansions over every colliding pair
+
+	// Adds up the narrowphase counters from another thread
+	void accumulate(const CollisionStats& other) {
+		pairs_colliding += other.pairs_colliding;
+		gjk_iterations += other.gjk_iterations;
+		gjk_warm_exits += other.gjk_warm_exits;
+		epa_iterations += other.epa_iterations;
+	}
+};
+
+struct RaycastHit {
+	Collider* collider = nullptr;
+	glm::vec2 point;
+	glm::vec2 normal; // Facing back out of the collider that was hit
+	float distance = 0;
+	float fraction = 0; // How far along the ray or cast the hit is, 0 to 1
+};
+
+// Where and how deep two colliders overlap, found by EPA for a colliding pair
+struct ContactManifold {
+	glm::vec2 normal = glm::vec2(0); // Unit length, points from the first collider towards the second
+	float depth = 0; // How far the second collider has to move along the normal to separate them
+	glm::vec2 points[2]; // World space
+	unsigned point_count = 0;
+};
+
+// Owns colliders that never move, like a tile map. Static colliders aren't in the broadphase, each
+// moving collider asks the registered sources for the ones near it instead, so they never test each other
+class StaticColliderSource {
+public:
+	virtual ~StaticColliderSource() = default;
+
+	// Appends the static colliders that might overlap region
+	virtual void queryStatic(const BoundingBox& region, std::vector<Collider*>& result) = 0;
+
+	// Calls callback(hit) for static colliders along the ray, it returns the distance to clip the ray to. Direction must
+	// be normalized. The default raycasts everything queryStatic() finds, sources that can find hits in order should override it
+	virtual void raycastStatic(glm::vec2 origin, glm::vec2 direction, float max_distance, const std::function<float(const RaycastHit&)>& callback);
+};
 
 class Collider : public Object2d {
 public:
-	Collider(std::string id);
+	enum BROADPHASE_TYPE {
+		SWEEP_AND_PRUNE, AABB_TREE
+	};
+
+	Collider(std::string id, bool is_static = false);
 	~Collider();
 
-	BoundingBox bounding_box;
-	float elasticity = 0;
+	const unsigned uid; // Unique for the lifetime of the program, used to identify pairs
+	const bool is_static; // Static colliders are owned by a StaticColliderSource and stay out of the broadphase
+	Rigidbody2d* body = nullptr; // The rigidbody this collider belongs to, if any
+	BoundingBox bounding_box; // World space bounds, recalculated once per step by updateBounds()
+	float elasticity = 0; // Restitution, the larger of the two is used for a contact
+	float friction = 0.3f; // Combined with the other collider's as sqrt(a * b)
+	uint32_t category = 1; // Bits for the layers this collider is in, queries skip colliders that don't share a bit with their mask
+	uint32_t mask = ~0u; // Layers this collider can touch, both colliders of a pair have to accept each other
 
 	glm::vec2 center; // Center of mass
 	float moi; // Moment of inertia
@@ -127,21 +231,132 @@ public:
 	virtual glm::vec2 furthestPoint(glm::vec2 direction) = 0;
 	virtual void calcAttribs(float mass) = 0;
 
-	static bool checkCollision(Collider& colliderA, Collider& colliderB, Simplex* resultSimplex);
-	static glm::vec2 resolutionVector(Collider& colliderA, Collider& colliderB, std::vector<glm::vec2> polytope);
+	virtual bool raycastShape(glm::vec2 origin, glm::vec2 direction, float max_distance, RaycastHit* hit) = 0; // Direction must be normalized
+	virtual unsigned supportFeature(glm::vec2 direction, glm::vec2 feature[2]) = 0; // The vertex or edge furthest along direction, returns how many points it filled
+
+	void updateTransform(); // Caches the world transform for this step, rebuilding the shape's cached data if it moved
+	void updateBounds();
+	void updateProxy(); // Updates the transform, bounds and tree leaf, done for every awake collider at the start of checkAll
+	bool containsPoint(glm::vec2 point);
+	glm::vec2 getWorldCenter() const; // Center of mass, from the transform cached this step
+	bool isSleeping() const; // True if this can't have moved since the last step, static colliders are always asleep
+
+	static bool checkCollision(Collider& colliderA, Collider& colliderB, Simplex* resultSimplex, GJKCache* cache = nullptr);
+	static bool contactManifold(Collider& colliderA, Collider& colliderB, Simplex& simplex, ContactManifold* manifold); // EPA, simplex must be from a colliding checkCollision
 	static void checkAll(float deltaTime);
 
-private:
-	static std::vector<Collider*> colliders;
+	// Collision filtering, checked by the broadphase before a pair goes anywhere near GJK. A pair is kept if each
+	// collider's category is in the other's mask, and the layer matrix lets at least one pair of their layers touch
+	static bool canCollide(const Collider& a, const Collider& b);
+	static void setLayersCollide(unsigned layer_a, unsigned layer_b, bool collide); // Layers are bit indices, 0 to 31
+	static uint32_t layerBit(const std::string& name); // The bit for a named layer, the name gets the next free layer if it's new. 0 once all 32 are taken
+	static uint32_t parseLayers(const Json::Value& j); // A layer name, an array of names, or the bits as a number
+	void loadFilter(const Json::Value& j); // Reads "category" and "mask" with parseLayers(), missing members are left alone
+	static void loadLayerMatrix(const Json::Value& j); // An array of [layer, layer] name pairs that never collide
+
+	// World queries, these use the bounding boxes from the last call to checkAll
+	static std::vector<Collider*> queryRegion(const BoundingBox& region);
+	static std::vector<Collider*> queryPoint(glm::vec2 point);
+	static bool raycast(glm::vec2 origin, glm::vec2 direction, float max_distance, RaycastHit* hit, uint32_t mask = ~0u); // Finds the closest hit along the ray
+	static unsigned raycastAll(glm::vec2 origin, glm::vec2 direction, float max_distance, std::vector<RaycastHit>& hits, uint32_t mask = ~0u); // Every hit, closest first
+
+	// Sweeps shape from from to to, as if its origin was moved there. The normal faces back towards the shape.
+	// The shape doesn't have to be part of the world, a collider made static works as a probe
+	static bool shapecast(Collider& shape, glm::vec2 from, glm::vec2 to, RaycastHit* hit, uint32_t mask = ~0u);
+	static unsigned shapecastAll(Collider& shape, glm::vec2 from, glm::vec2 to, std::vector<RaycastHit>& hits, uint32_t mask = ~0u); // Closest first
+
+	// Continuous collision, only the translation is swept. toi is the fraction of translation
+	// that can be travelled before touching, shapes that already overlap are never hit
+	static bool timeOfImpact(Collider& moving, glm::vec2 translation, Collider& target, float* toi, glm::vec2 offset = glm::vec2(0)); // offset moves the shape before sweeping
+	static bool sweep(Collider& moving, glm::vec2 translation, float* toi, Collider** hit = nullptr); // Finds the earliest hit against every other collider
+
+	static BROADPHASE_TYPE broadphase;
+	static CollisionStats stats;
+	static unsigned gjk_max_iterations;
+	static unsigned gjk_cache_lifetime; // Steps a pair can go untested before its cache entry is dropped
+	static float epa_tolerance; // EPA stops once expanding the polytope gains less than this
+	static unsigned epa_max_iterations;
+	static unsigned toi_iterations; // Bisection steps for timeOfImpact, each one halves the error
+
+	static constexpr unsigned epa_capacity = 64; // Most edges the EPA polytope can hold, it stops expanding when full
+
+	static unsigned narrowphase_batch_size; // Pairs each worker takes at a time, fewer pairs than this run on the calling thread
+	static void addStaticSource(StaticColliderSource* source);
+	static void removeStaticSource(StaticColliderSource* source);
+
+	static void setNarrowphaseThreads(unsigned count); // Extra threads besides the one calling checkAll, defaults to one less than the core count
+
+protected:
+	glm::mat4 world_transform = glm::mat4(1); // Cached by updateTransform()
+	Affine2d world_affine;
+	bool transform_cached = false;
+
+	virtual void transformChanged() {} // Called when the cached world transform is different from the last one
 
-	static glm::vec2 getSupport(Collider& a, Collider& b, glm::vec2 direction);
 	static const glm::vec2 normalCW(glm::vec2 vec);	
 	static const glm::vec2 normalCCW(glm::vec2 vec);
+
+private:
+	OBJECT_TYPE_ID(Collider);
+
+	int proxy = -1; // This collider's leaf in the tree, -1 until the first step
+
+	struct PairContact {
+		unsigned pair; // Index into pairs
+		ContactManifold manifold;
+	};
+
+	// Each worker writes into its own buffer, they're merged once every pair is done
+	struct NarrowphaseBuffer {
+		std::vector<PairContact> contacts;
+		CollisionStats stats;
+	};
+
+	static std::vector<Collider*> colliders; // Kept sorted by the left edge of each bounding box, see sortColliders()
+	static std::vector<ColliderPair> pairs; // Pairs from the broadphase for this step, the lower uid first
+	static std::vector<StaticColliderSource*> static_sources;
+	static std::vector<Collider*> static_query; // Reused by findStaticPairs()
+	static std::vector<std::pair<Rigidbody2d*, Rigidbody2d*>> body_contacts; // Reused to build islands each step
+	static AABBTree tree;
+	static std::unordered_map<uint64_t, GJKCache> gjk_cache;
+	static std::vector<GJKCache*> pair_caches; // The cache entry for each pair, looked up before the narrowphase so workers never touch the map
+	static std::vector<NarrowphaseBuffer> buffers;
+	static std::vector<PairContact> contacts; // Every contact from this step, in pair order
+	static WorkerPool workers;
+	static thread_local CollisionStats thread_stats; // Narrowphase counters for the calling thread
+	static unsigned step; // Counts calls to checkAll
+	static unsigned next_uid;
+
+	static uint32_t layer_ignore[32]; // For each layer, the layers it never collides with. Kept symmetric
+	static std::vector<std::string> layer_names; // Index is the layer, layer 0 is "default"
+
+	static uint64_t pairKey(const Collider& a, const Collider& b);
+	static void evictCache();
+
+	static void updateTree();
+	static void sortColliders();
+	static void findPairsSweep();
+	static void findPairsTree();
+	static void findStaticPairs();
+	static void narrowphase();
+
+	template<typename Support>
+	static bool gjk(Support support, Simplex* resultSimplex, GJKCache* cache = nullptr);
+	static bool triangleContainsOrigin(Simplex& points);
+
+	static glm::vec2 getSupport(Collider& a, Collider& b, glm::vec2 direction);
 	static bool sameDirection(const glm::vec2& direction, const glm::vec2& ao);
 
 	static bool nextSimplex(Simplex& points, glm::vec2& direction);
 	static bool lineCheck(Simplex& points, glm::vec2& direction);
 	static bool triangleCheck(Simplex& points, glm::vec2& direction);
+
+	static void findContactPoints(Collider& colliderA, Collider& colliderB, ContactManifold* manifold);
+
+	template<typename Support>
+	static bool epa(Support support, Simplex& simplex, glm::vec2* normal, float* depth);
+	static void gatherCandidates(const BoundingBox& region, std::vector<Collider*>& result); // Dynamic and static colliders whose boxes might overlap region
+	static bool castShape(Collider& shape, glm::vec2 offset, glm::vec2 translation, Collider& target, RaycastHit* hit);
 };
 
 struct CircleCollider : public Collider {
@@ -151,40 +366,44 @@ public:
 	float radius;
 
 	glm::vec2 furthestPoint(glm::vec2 direction) override {
-		return glm::normalize(direction) * radius;
+		if(!transform_cached)
+			updateTransform();
+		return world_center + glm::normalize(direction) * radius;
 	}
 
 	void calcAttribs(float mass) override {
 		center = glm::vec2(0);
-		moi = glm::pi<float>() * pow(radius, 4) / 4;
+		moi = glm::pi<float>() * radius * radius * radius * radius / 4;
+	}
+
+	bool raycastShape(glm::vec2 origin, glm::vec2 direction, float max_distance, RaycastHit* hit) override;
+
+	unsigned supportFeature(glm::vec2 direction, glm::vec2 feature[2]) override {
+		feature[0] = furthestPoint(direction);
+		return 1;
+	}
+
+protected:
+	glm::vec2 world_center = glm::vec2(0);
+
+	void transformChanged() override {
+		world_center = world_transform[3];
 	}
 };
 
 struct MeshCollider : public Collider {
-	MeshCollider(std::string id, std::vector<glm::vec2> points);
+	MeshCollider(std::string id, std::vector<glm::vec2> points, bool is_static = false);
 
 	// Object2d& setPos(glm::vec2 position) override;
 	// Object2d& setRot(float angle) override;
 	// Object2d& setScl(glm::vec2 scale) override;
 
-	glm::vec2 furthestPoint(glm::vec2 direction) override {
-		glm::vec2 max_point;
-		float max_dist = -std::numeric_limits<float>::max();
-
-		for(auto vert : vertices) {
-			vert = getWorldTransform() * glm::vec4(vert, 0, 1);
-			float distance = glm::dot(vert, direction);
-			if(distance > max_dist) {
-				max_dist = distance;
-				max_point = vert;
-			}
-		}
-
-		return max_point;
-	}
+	glm::vec2 furthestPoint(glm::vec2 direction) override;
 
 	void calcAttribs(float mass) override {
 		float area = 0;
+		center = glm::vec2(0);
+		moi = 0;
 
 		auto prev = vertices.end() - 1;
 		for (auto it = vertices.begin(); it != vertices.end(); it++) {
@@ -207,6 +426,22 @@ struct MeshCollider : public Collider {
 		moi -= mass * glm::dot(center, center);
 	}
 
+	bool raycastShape(glm::vec2 origin, glm::vec2 direction, float max_distance, RaycastHit* hit) override;
+	unsigned supportFeature(glm::vec2 direction, glm::vec2 feature[2]) override;
+
+	// Hulls with more vertices than this find support points by walking the hull instead of checking every vertex
+	static constexpr unsigned hill_climb_threshold = 8;
+
+protected:
+	void transformChanged() override;
+
 private:
 	std::vector<glm::vec2> vertices;
+	std::vector<glm::vec2> hull; // Convex hull of vertices, counter clockwise
+	std::vector<glm::vec2> world_hull; // The hull transformed into world space, cached once per step
+	std::atomic<unsigned> last_support{0}; // Where the last support search ended, the next search starts from here. Only a hint, so workers can race on it
+
+	unsigned supportIndex(glm::vec2 direction); // Index into world_hull of the support point
+
+	static std::vector<glm::vec2> convexHull(std::vector<glm::vec2> points);
 };
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "collider.h"
+
+#include <vector>
+#include <cstdint>
+
+struct CollisionEvent {
+	enum TYPE {
+		BEGIN, // The pair started touching this step
+		STAY, // The pair was touching last step too, sleeping pairs stay touching without being tested
+		END // The pair stopped touching, or one of them was filtered out or destroyed
+	};
+
+	TYPE type;
+	uint64_t key; // Identifies the pair, events are sorted by it
+	Collider* a; // The collider with the lower uid. Null in an END event if it was destroyed
+	Collider* b;
+	ContactManifold manifold; // The normal points from a to b. END events keep the last manifold the pair had
+
+	// Whether collider is either side of the pair, and the other side if so
+	bool involves(const Collider* collider) const { return a == collider || b == collider; }
+	Collider* other(const Collider* collider) const { return a == collider ? b : a; }
+};
+
+// The contacts found by each Collider::checkAll, compared against the last step's and turned into one event per
+// touching pair. Gameplay reads the whole list once after the physics step instead of reacting inside the pair loop
+class CollisionEvents {
+public:
+	static const std::vector<CollisionEvent>& get(); // This step's events, valid until the next checkAll
+
+	// Used by Collider::checkAll, contacts can come in any order and more than once
+	static void record(Collider& a, Collider& b, uint64_t key, const ContactManifold& manifold);
+	static void finish(); // Builds the events out of everything recorded since the last call
+
+	static void forget(const Collider* collider); // Clears pointers to a destroyed collider, its pairs end next step
+
+private:
+	struct Touch {
+		uint64_t key;
+		Collider* a;
+		Collider* b;
+		ContactManifold manifold;
+	};
+
+	static std::vector<Touch> touching; // Sorted by key, the pairs touching as of the last finish()
+	static std::vector<Touch> recorded; // Since the last finish(), reused to build the next touching list
+	static std::vector<CollisionEvent> events;
+};
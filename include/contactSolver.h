@@ -0,0 +1,89 @@
+#pragma once
+
+#include "collider.h"
+
+#include "glm/glm.hpp"
+
+#include <vector>
+#include <unordered_map>
+
+// Sequential impulses: each contact point pushes its two bodies apart at the velocity level, and the
+// points are worked through a few times so the pushes settle against each other. The impulses a contact
+// ended up with are kept and applied up front next step, so resting stacks start out almost solved.
+// Overlap is pushed out the same way but with a second velocity that only moves the bodies for this
+// step, so separating them doesn't leave them moving apart afterwards
+class ContactSolver {
+public:
+	// Queues a contact for the next solve(). key identifies the pair across steps, the normal points from a to b
+	static void addContact(Collider& a, Collider& b, uint64_t key, const ContactManifold& manifold);
+	static void solve(float deltaTime); // Updates the velocities of every body in a queued contact, then clears the queue
+
+	static unsigned velocity_iterations;
+	static unsigned position_iterations;
+	static float baumgarte; // Fraction of the penetration past penetration_slop that gets pushed out each step
+	static float penetration_slop; // Overlap that's left alone, so resting contacts don't jitter in and out
+	static float restitution_threshold; // Closing speeds below this don't bounce
+	static float warm_start_distance; // How far a contact point can move between steps and keep its impulse
+	static bool warm_starting;
+
+private:
+	// Velocities in radians, gathered from the bodies before solving and written back after
+	struct SolverBody {
+		glm::vec2 velocity = glm::vec2(0);
+		float angular_velocity = 0;
+		glm::vec2 push_velocity = glm::vec2(0); // Only moves the body for this step, then it's thrown away
+		float inv_mass = 0;
+		float inv_inertia = 0;
+		Rigidbody2d* body = nullptr; // Null for the slot shared by everything that can't move
+	};
+
+	struct SolverPoint {
+		glm::vec2 position;
+		glm::vec2 r_a, r_b; // From each body's center of mass
+		float normal_mass, tangent_mass;
+		float normal_impulse, tangent_impulse; // Accumulated over the iterations
+		float bias; // Target separating speed, for bouncing
+	};
+
+	struct SolverContact {
+		uint64_t key;
+		unsigned body_a, body_b; // Into solver_bodies
+		glm::vec2 normal;
+		float friction;
+		float push_mass, push_impulse;
+		float push_bias; // Target separating push speed, for the overlap
+		SolverPoint points[2];
+		unsigned point_count;
+	};
+
+	struct CachedImpulses {
+		glm::vec2 points[2];
+		float normal_impulse[2];
+		float tangent_impulse[2];
+		unsigned point_count = 0;
+		unsigned last_step = 0;
+	};
+
+	struct Contact {
+		Collider* a;
+		Collider* b;
+		uint64_t key;
+		ContactManifold manifold;
+	};
+
+	// All reused between steps
+	static std::vector<Contact> contacts;
+	static std::vector<SolverBody> solver_bodies;
+	static std::vector<int> body_slots; // Each body's slot in solver_bodies by store index, -1 if it isn't in a contact
+	static std::vector<SolverContact> solver_contacts;
+	static std::unordered_map<uint64_t, CachedImpulses> impulse_cache;
+	static unsigned step;
+
+	static unsigned bodySlot(Collider& collider);
+	static void prepare(const Contact& contact, float deltaTime);
+	static void warmStart(SolverContact& contact);
+	static void solveContact(SolverContact& contact);
+	static void solvePush(SolverContact& contact);
+	static void storeImpulses();
+	static void applyImpulse(SolverContact& contact, const SolverPoint& point, glm::vec2 impulse);
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cmath>
+
+// Trig for the simulation. libm's sin, cos and acos are allowed to round differently on every platform,
+// so builds with the deterministic option use these versions, made only of operations IEEE 754 rounds
+// exactly (+, -, *, /, sqrt, floor, fmod). With -ffp-contract=off they give the same bits everywhere.
+// Other builds just forward to the standard library
+namespace dmath {
+#ifdef DETERMINISTIC_PHYSICS
+	constexpr bool deterministic = true;
+
+	namespace detail {
+		constexpr float pi = 3.14159265358979f;
+		constexpr double half_pi = 1.5707963267948966; // The radian reduction runs in double so it doesn't lose bits
+
+		// Taylor series, accurate to a few ulps for |x| <= pi / 4
+		inline float sinPoly(float x) {
+			float x2 = x * x;
+			return x + x * x2 * (-1 / 6.f + x2 * (1 / 120.f + x2 * (-1 / 5040.f + x2 * (1 / 362880.f))));
+		}
+
+		inline float cosPoly(float x) {
+			float x2 = x * x;
+			return 1 + x2 * (-1 / 2.f + x2 * (1 / 24.f + x2 * (-1 / 720.f + x2 * (1 / 40320.f + x2 * (-1 / 3628800.f)))));
+		}
+
+		// x within pi / 4 of quadrant * pi / 2
+		inline void sinCosQuadrant(float x, int quadrant, float* s, float* c) {
+			float sin_x = sinPoly(x);
+			float cos_x = cosPoly(x);
+			switch(quadrant & 3) {
+				case 0: *s = sin_x;  *c = cos_x;  break;
+				case 1: *s = cos_x;  *c = -sin_x; break;
+				case 2: *s = -sin_x; *c = -cos_x; break;
+				case 3: *s = -cos_x; *c = sin_x;  break;
+			}
+		}
+
+		// For 0 <= x <= 1
+		inline float atanUnit(float x) {
+			// atan(x) = pi / 6 + atan((x - 1 / sqrt(3)) / (1 + x / sqrt(3))), brings x under tan(pi / 12)
+			const float inv_sqrt3 = 0.57735026918962f;
+			float offset = 0;
+			if(x > 0.26794919243f) {
+				x = (x - inv_sqrt3) / (1 + x * inv_sqrt3);
+				offset = pi / 6;
+			}
+			float x2 = x * x;
+			return offset + x + x * x2 * (-1 / 3.f + x2 * (1 / 5.f + x2 * (-1 / 7.f + x2 * (1 / 9.f))));
+		}
+	}
+
+	// Degrees are reduced exactly, so whole turns of rotation never drift
+	inline void sinCosDeg(float degrees, float* s, float* c) {
+		float angle = std::fmod(degrees, 360.f);
+		float quadrant = std::floor((angle + 45.f) / 90.f);
+		detail::sinCosQuadrant((angle - quadrant * 90.f) * (detail::pi / 180.f), (int)quadrant, s, c);
+	}
+
+	inline void sinCos(float radians, float* s, float* c) {
+		double quadrant = std::floor(radians / detail::half_pi + 0.5);
+		float x = (float)(radians - quadrant * detail::half_pi);
+		detail::sinCosQuadrant(x, (int)std::fmod(quadrant, 4.0) + 4, s, c);
+	}
+
+	inline float atan2(float y, float x) {
+		float ay = std::fabs(y), ax = std::fabs(x);
+		if(ax == 0 && ay == 0)
+			return 0;
+
+		float angle = ay <= ax ? detail::atanUnit(ay / ax) : detail::pi / 2 - detail::atanUnit(ax / ay);
+		if(x < 0)
+			angle = detail::pi - angle;
+		return y < 0 ? -angle : angle;
+	}
+
+	inline float acos(float x) {
+		x = std::fmin(std::fmax(x, -1.f), 1.f);
+		return atan2(std::sqrt((1 - x) * (1 + x)), x);
+	}
+#else
+	constexpr bool deterministic = false;
+
+	inline void sinCosDeg(float degrees, float* s, float* c) {
+		float radians = degrees * 0.017453292519943f;
+		*s = std::sin(radians);
+		*c = std::cos(radians);
+	}
+
+	inline void sinCos(float radians, float* s, float* c) {
+		*s = std::sin(radians);
+		*c = std::cos(radians);
+	}
+
+	inline float atan2(float y, float x) { return std::atan2(y, x); }
+	inline float acos(float x) { return std::acos(x); }
+#endif
+
+	inline float sinDeg(float degrees) { float s, c; sinCosDeg(degrees, &s, &c); return s; }
+	inline float cosDeg(float degrees) { float s, c; sinCosDeg(degrees, &s, &c); return c; }
+	inline float sin(float radians) { float s, c; sinCos(radians, &s, &c); return s; }
+	inline float cos(float radians) { float s, c; sinCos(radians, &s, &c); return c; }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "transformStore.h"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+
+// Plain data components for a World. Each mirrors what the Object class of the same name keeps, without the hierarchy
+namespace ecs {
+	struct Transform {
+		glm::vec2 pos = glm::vec2(0);
+		float rot = 0; // Degrees, like Object2d
+		glm::vec2 scl = glm::vec2(1);
+		float layer = 1;
+		Affine2d world; // Filled in by updateTransforms()
+	};
+
+	struct Rigidbody {
+		glm::vec2 velocity = glm::vec2(0);
+		float angular_velocity = 0; // Degrees per second
+		glm::vec2 force = glm::vec2(0); // Accumulated until the next integrate()
+		float torque = 0;
+		float inv_mass = 1;
+		float inv_moi = 1;
+	};
+
+	// A circle, enough for the crowds a World is for. Filtered the same way as ::Collider
+	struct Collider {
+		float radius = 0.5f;
+		uint32_t category = 1;
+		uint32_t mask = ~0u;
+		glm::vec2 lower_left = glm::vec2(0), upper_right = glm::vec2(0); // World space box, filled in by updateBounds()
+	};
+
+	struct Sprite {
+		unsigned texture = 0; // GL texture name
+		glm::vec2 size = glm::vec2(1);
+		int layer = 1;
+		bool visible = true;
+	};
+
+	struct Ship {
+		float thrust_power = 0; // Copied from the ShipClass when spawned
+		float turn_power = 0;
+		float thrust = 0; // This step's input, -1 to 1
+		float turn = 0;
+		glm::vec2 drift = glm::vec2(0);
+	};
+}
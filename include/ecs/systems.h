@@ -0,0 +1,12 @@
+#pragma once
+
+#include "ecs/world.h"
+#include "ecs/components.h"
+
+// Systems over a World. Each one is a single each() over the components it reads, so it runs straight down their arrays
+namespace ecs {
+	void steerShips(World& world); // Applies drag and each Ship's input as forces, then clamps its speed like ::Ship::update
+	void integrate(World& world, float deltaTime); // Semi-implicit Euler with BodyStore's rest thresholds, there's no sleeping or sweeping
+	void updateTransforms(World& world); // Composes Transform::world, there's no hierarchy so local is world
+	void updateBounds(World& world); // Boxes each Collider around its circle, after updateTransforms()
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "logs.h"
+
+#include <vector>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <type_traits>
+#include <cstdint>
+
+// Entity-component storage for stages with more entities than the Object hierarchy handles well. Entities with the
+// same set of components share an archetype, which keeps one packed array per component, so a system reading a few
+// components walks a few arrays front to back instead of chasing pointers into the heap
+namespace ecs {
+	struct Entity {
+		uint32_t index = ~0u;
+		uint32_t generation = 0; // Bumped when the index is reused, so old handles to it stop being alive()
+
+		bool operator==(Entity o) const { return index == o.index && generation == o.generation; }
+		bool operator!=(Entity o) const { return !(*this == o); }
+	};
+
+	class World {
+	public:
+		static constexpr unsigned max_components = 64; // Component types, across every world
+
+		World();
+
+		Entity create();
+		void destroy(Entity e);
+		bool alive(Entity e) const;
+		unsigned size() const { return live; }
+
+		// Adding or removing a component moves the entity to another archetype, which moves the rest of its components
+		// too. Pointers and references to components are only good until the next add, remove, create or destroy
+		template<class C> C& add(Entity e, C component = C()); // Replaces the component if the entity already has one
+		template<class C> void remove(Entity e);
+		template<class C> C* get(Entity e); // nullptr if the entity doesn't have one
+		template<class C> bool has(Entity e) const;
+
+		// Calls fn(Cs&...), or fn(Entity, Cs&...), for every entity that has all of Cs. Entities can't be created or
+		// destroyed and components can't be added or removed inside fn, collect them and do it afterwards
+		template<class... Cs, class F> void each(F fn);
+
+		template<class C> static unsigned componentId() {
+			static const unsigned id = newComponentId(std::make_unique<Column<C>>());
+			return id;
+		}
+
+	private:
+		struct ColumnBase {
+			virtual ~ColumnBase() = default;
+			virtual std::unique_ptr<ColumnBase> emptyCopy() const = 0;
+			virtual void moveRow(unsigned row, ColumnBase& to) = 0; // Appends the row to another column of the same type
+			virtual void removeRow(unsigned row) = 0; // Moves the last row into its place
+		};
+
+		template<class C>
+		struct Column : ColumnBase {
+			std::vector<C> items;
+
+			std::unique_ptr<ColumnBase> emptyCopy() const override { return std::make_unique<Column<C>>(); }
+			void moveRow(unsigned row, ColumnBase& to) override { static_cast<Column<C>&>(to).items.push_back(std::move(items[row])); }
+			void removeRow(unsigned row) override {
+				if(row + 1 != items.size())
+					items[row] = std::move(items.back());
+				items.pop_back();
+			}
+		};
+
+		struct Archetype {
+			uint64_t mask = 0; // Bit per component id
+			std::vector<Entity> entities; // Row order, same as every column
+			std::vector<std::unique_ptr<ColumnBase>> columns;
+			int8_t column_of[max_components]; // Index into columns by component id, -1 for components it doesn't have
+			std::unordered_map<unsigned, unsigned> with, without; // Archetypes one component away, filled in as they're used
+
+			template<class C> std::vector<C>& column() { return static_cast<Column<C>*>(columns[column_of[componentId<C>()]].get())->items; }
+		};
+
+		struct Location {
+			uint32_t archetype = 0;
+			uint32_t row = 0;
+			uint32_t generation = 0;
+		};
+
+		std::vector<Location> locations; // By entity index
+		std::vector<uint32_t> free_indices;
+		std::vector<std::unique_ptr<Archetype>> archetypes; // The first one has no components
+		std::unordered_map<uint64_t, unsigned> archetype_of_mask;
+		unsigned live = 0;
+
+		static std::vector<std::unique_ptr<ColumnBase>>& prototypes(); // An empty column of each component type, by id
+		static unsigned newComponentId(std::unique_ptr<ColumnBase> prototype);
+
+		unsigned archetypeFor(uint64_t mask);
+		unsigned neighbor(unsigned from, unsigned component, bool adding); // The archetype with component added or taken away
+		void move(Entity e, unsigned to); // Carries over the components both archetypes have, the caller fills in any new one
+		void removeRow(Archetype& archetype, unsigned row);
+
+		template<class... Cs, class F> static void eachIn(Archetype& archetype, F& fn);
+	};
+
+	template<class C>
+	C& World::add(Entity e, C component) {
+		if(C* existing = get<C>(e))
+			return *existing = std::move(component);
+
+		unsigned to = neighbor(locations[e.index].archetype, componentId<C>(), true);
+		move(e, to);
+		std::vector<C>& column = archetypes[to]->column<C>();
+		column.push_back(std::move(component));
+		return column.back();
+	}
+
+	template<class C>
+	void World::remove(Entity e) {
+		if(!has<C>(e))
+			return;
+		move(e, neighbor(locations[e.index].archetype, componentId<C>(), false));
+	}
+
+	template<class C>
+	C* World::get(Entity e) {
+		if(!alive(e))
+			return nullptr;
+		const Location& location = locations[e.index];
+		Archetype& archetype = *archetypes[location.archetype];
+		if(archetype.column_of[componentId<C>()] == -1)
+			return nullptr;
+		return &archetype.column<C>()[location.row];
+	}
+
+	template<class C>
+	bool World::has(Entity e) const {
+		return alive(e) && archetypes[locations[e.index].archetype]->column_of[componentId<C>()] != -1;
+	}
+
+	template<class... Cs, class F>
+	void World::each(F fn) {
+		const uint64_t mask = ((uint64_t(1) << componentId<Cs>()) | ... | 0);
+		for(auto& archetype : archetypes) {
+			if((archetype->mask & mask) == mask && !archetype->entities.empty())
+				eachIn<Cs...>(*archetype, fn);
+		}
+	}
+
+	template<class... Cs, class F>
+	void World::eachIn(Archetype& archetype, F& fn) {
+		std::tuple<Cs*...> columns(archetype.column<Cs>().data()...); // Looked up once per archetype, not per entity
+		unsigned count = archetype.entities.size();
+		for(unsigned i = 0; i < count; i++) {
+			if constexpr(std::is_invocable<F&, Entity, Cs&...>::value)
+				fn(archetype.entities[i], std::get<Cs*>(columns)[i]...);
+			else
+				fn(std::get<Cs*>(columns)[i]...);
+		}
+	}
+}
@@ -14,4 +14,5 @@ public:
 
 private:
 	std::vector<glm::ivec2> calcChunkCoords(glm::ivec2 offset);
+	OBJECT_TYPE_ID(ChunkLoader);
 };
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "render.h"
+#include "shader.h"
+#include "mesh2d.h"
+#include "texture.h"
+#include "collider.h"
+
+#include "glm/glm.hpp"
+
+#include <vector>
+#include <string>
+
+struct ProjectileType {
+	std::string name;
+	std::string sprite_path;
+	glm::vec2 size = glm::vec2(0.1f, 0.3f); // Drawn size, the sprite points along +y
+	float lifetime = 2; // Seconds
+	float damage = 1;
+	float mass = 0.01f; // Only used for how hard it pushes what it hits
+	uint32_t mask = ~0u; // Collider categories it hits
+	unsigned capacity = 4096; // Most projectiles of this type alive at once
+};
+
+struct ProjectileHit {
+	Collider* collider;
+	glm::vec2 point;
+	glm::vec2 normal;
+	glm::vec2 velocity; // The projectile's, at impact
+	float damage;
+};
+
+class ProjectilePool;
+
+// Fires projectiles from a pool for as long as the trigger is held, at most once every cooldown_ticks.
+// The trigger is set from input, update() is called once per tick so the fire rate doesn't follow the frame rate
+struct Weapon {
+	ProjectilePool* pool = nullptr;
+	float muzzle_speed = 30; // Added to the shooter's velocity
+	unsigned cooldown_ticks = 6;
+	bool trigger = false;
+
+	void update(glm::vec2 position, glm::vec2 direction, glm::vec2 velocity, Collider* owner = nullptr);
+
+private:
+	unsigned cooldown = 0; // Ticks until it can fire again
+};
+
+// Every live projectile of one type, packed into fixed size arrays. Projectiles aren't objects, they're points
+// moved and raycast in one pass per tick, removed by swapping the last one into their place, and drawn with one instanced call
+class ProjectilePool : private Renderable {
+public:
+	ProjectilePool(ProjectileType type, int layer = 1);
+	~ProjectilePool();
+
+	ProjectilePool(const ProjectilePool&) = delete;
+	ProjectilePool& operator=(const ProjectilePool&) = delete;
+
+	const ProjectileType type;
+
+	// Returns false if the pool is full. Projectiles never hit their owner
+	bool spawn(glm::vec2 position, glm::vec2 velocity, Collider* owner = nullptr);
+	void clear();
+
+	unsigned size() const;
+	const std::vector<ProjectileHit>& getHits() const; // What the last update() hit, in pool order. Removing projectiles reorders the pool, so this isn't spawn order
+
+	void update(float deltaTime); // Moves every projectile, and pushes the bodies of whatever they hit
+	void draw(Shader& shader) override;
+
+	static void updateAll(float deltaTime); // Updates every pool, then takes the damage off the ships they hit
+	static ProjectilePool* find(const std::string& type_name);
+	static Shader* defaultShader();
+
+private:
+	unsigned count = 0;
+	std::vector<float> pos_x, pos_y;
+	std::vector<float> last_x, last_y; // Where each one was before this tick, for blending when drawn
+	std::vector<float> vel_x, vel_y;
+	std::vector<float> age;
+	std::vector<Collider*> owners;
+	std::vector<uint8_t> dead;
+
+	std::vector<ProjectileHit> hits;
+	std::vector<RaycastHit> owner_hits; // Reused when the owner is in the way
+
+	Texture texture;
+	Polygon mesh = Primitive::rect();
+	std::vector<glm::vec4> instances; // Position and facing, rebuilt for each draw
+	unsigned VAO, VBO, EBO, IBO;
+
+	void init_buffers();
+	bool findHit(unsigned index, float deltaTime, RaycastHit* hit);
+	void remove(unsigned index);
+
+	static std::vector<ProjectilePool*> pools;
+	static const char* default_shader_path_vert;
+	static const char* default_shader_path_frag;
+};
@@ -5,6 +5,8 @@
 #include "input.h"
 #include "rigidbody2d.h"
 #include "collider.h"
+#include "hullBaker.h"
+#include "game/projectiles.h"
 
 #include "glm/glm.hpp"
 
@@ -17,6 +19,11 @@ struct ShipClass {
 	float thrust_power;
 	float turn_power;
 	unsigned weapon_slots;
+	Json::Value collision = Json::Value(); // "category" and "mask" for the hull's collider, see Collider::loadFilter()
+	unsigned hull_vertices = HullBaker::default_vertex_budget; // Most vertices the collider baked from the sprite can have
+	float health = 100;
+
+	static ShipClass fromJson(const Json::Value& j);
 };
 
 class Ship : public Object2d {
@@ -27,10 +34,21 @@ public:
 	glm::vec2 drift = glm::vec2(0);
 	ShipClass ship_class;
 
+	// What the ship is being told to do, from -1 to 1. Binds fill these in once per frame and update() applies them
+	// every tick, so holding a key pushes just as hard whatever the frame rate. clearControls() before reading input again
+	float thrust = 0;
+	float turn = 0;
+	void clearControls();
+
+	Weapon weapon; // Fires from the nose, its trigger is cleared with the other controls
+	float health;
+	ComponentRef<Rigidbody2d> rigidbody = ComponentRef<Rigidbody2d>(this, "rigidbody");
+
 
 	void update(float deltaTime);
 
 	static void updateShips(float deltaTime);
+	static void applyHits(const std::vector<ProjectileHit>& hits); // Takes the damage off each ship that was hit
 
 	static std::vector<ShipClass> ship_classes;
 
@@ -41,11 +59,13 @@ private:
 	const float ROT_VELOCITY_MAX = 300;
 	
 	static std::vector<Ship*> ships;
+	OBJECT_TYPE_ID(Ship);
 };
 
 class PlayerShip : public Ship {
 public:
 	PlayerShip() : Ship("player", "testclass") {
+		rigidbody->setFast(true);
 		init_control();
 		control.activate();
 	}
@@ -54,19 +74,19 @@ public:
 
 	void init_control() {
 		control.addBind("down", 
-			[this](){ get<Rigidbody2d>("rigidbody").applyForce(-this->up() * ship_class.thrust_power); },
+			[this](){ thrust -= 1; },
 			GLFW_KEY_S
 		);
 		control.addBind("up", 
-			[this](){ get<Rigidbody2d>("rigidbody").applyForce(this->up() * ship_class.thrust_power); },
+			[this](){ thrust += 1; },
 			GLFW_KEY_W
 		);
 		control.addBind("left", 
-			[this](){ get<Rigidbody2d>("rigidbody").applyTorque(ship_class.turn_power); },
+			[this](){ turn += 1; },
 			GLFW_KEY_A
 		);
 		control.addBind("right", 
-			[this](){ get<Rigidbody2d>("rigidbody").applyTorque(-ship_class.turn_power); },
+			[this](){ turn -= 1; },
 			GLFW_KEY_D
 		);
 		control.addBind("boost", 
@@ -78,4 +98,7 @@ public:
 			GLFW_KEY_LEFT_SHIFT, INPUT_ONCE_RELEASE
 		);
 	}
+
+private:
+	OBJECT_TYPE_ID(PlayerShip);
 };
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "mesh2d.h"
 #include "shader.h"
 #include "render.h"
+#include "collider.h"
 
 #include "glad/glad.h"
 #include "glm/glm.hpp"
@@ -15,8 +16,10 @@
 #include <vector>
 #include <fstream>
 #include <forward_list>
+#include <memory>
+#include <limits>
 
-class TileGrid : private Renderable {
+class TileGrid : private Renderable, public StaticColliderSource {
 public:
 	struct Tile {
 		unsigned tileID;
@@ -47,6 +50,7 @@ public:
 		int layer = 0
 	);
 	TileGrid(std::string path, unsigned chunk_slots = 9, int layer = 0);
+	~TileGrid();
 
 	// This grids chunks, declared by a map file and loaded in when needed
 	std::map<unsigned, Chunk*> chunk_slots;
@@ -58,6 +62,7 @@ public:
 	Chunk* getChunk(glm::vec2 position);
 	Chunk* getChunkFromGridPos(glm::ivec2 chunk_pos);
 	glm::ivec2 calcChunkPos(glm::vec2 world_pos);
+	glm::ivec2 calcTilePos(glm::vec2 world_pos); // The tile covering world_pos, tiles are tile_size apart and centered on their position
 
 	Chunk* addTileToGrid(glm::vec2 position, unsigned tileID, unsigned attribs = NONE);
 	Chunk* removeTileFromGrid(glm::vec2 position);
@@ -72,6 +77,11 @@ public:
 	void markChunk(Chunk* chunk);
 	void draw(Shader& shader); // Draws tiles from the currently loaded chunks using data in the IBO (from updateTiles())
 
+	// Solid tiles are merged into as few rectangles as possible per chunk, these are rebuilt when the chunk is next queried after an edit
+	const std::vector<std::shared_ptr<MeshCollider>>& getChunkColliders(glm::ivec2 chunk_pos);
+	void queryStatic(const BoundingBox& region, std::vector<Collider*>& result) override; // Only looks in the chunks the region overlaps
+	void raycastStatic(glm::vec2 origin, glm::vec2 direction, float max_distance, const std::function<float(const RaycastHit&)>& callback) override; // Steps through the grid a tile at a time
+
 	bool loadFile(std::string); // Reads texture data and chunk positions into the grid
 	void saveFile(std::string); // Saves all chunks and texture data to a readable map file
 
@@ -80,14 +90,31 @@ public:
 private:
 	// const unsigned format_version = 0;
 	unsigned VAO, EBO;
-	glm::uvec2 tile_size; // The amount of world units the tiles should be
+	glm::uvec2 tile_size; // The amount of world units the tiles should be, and how far apart they are
 	glm::uvec2 chunk_size = glm::uvec2(32); // Columns and rows in a chunk
 	std::string path;
 	std::forward_list<Chunk> chunks;
+	glm::ivec2 chunk_min = glm::ivec2(std::numeric_limits<int>::max()); // The lowest and highest chunk positions in chunks, min > max while there aren't any
+	glm::ivec2 chunk_max = glm::ivec2(std::numeric_limits<int>::min());
 	std::map<unsigned, TexMap> textures; 
 
+	struct ChunkColliders {
+		std::vector<std::shared_ptr<MeshCollider>> colliders;
+		std::vector<int> cells; // The collider covering each tile in row order, -1 for empty tiles. Empty if the chunk has no tiles
+		bool dirty = true;
+	};
+	std::unordered_map<uint64_t, ChunkColliders> chunk_colliders; // Keyed by chunkKey(), only for chunks that exist
+	static const ChunkColliders no_colliders; // What getChunkEntry() returns where there's no chunk
+
+	glm::vec2 tilePitch() const; // How far apart tiles are, tile_size but never 0
 	void initBuffers(unsigned slot_count); // Called once to initalize buffers, setting up `slot_count` slots
 
+	Chunk* findChunk(glm::ivec2 chunk_pos); // Like getChunkFromGridPos() but doesn't create the chunk, returns nullptr if there isn't one
+	void markCollidersDirty(glm::ivec2 chunk_pos);
+	const ChunkColliders& getChunkEntry(glm::ivec2 chunk_pos); // Rebuilds the chunk's colliders first if they're dirty
+	void buildColliders(const Chunk& chunk, ChunkColliders& entry);
+	static uint64_t chunkKey(glm::ivec2 chunk_pos);
+
 	static const char* default_shader_path_vert;
 	static const char* default_shader_path_frag;
 };
\ No newline at end of file
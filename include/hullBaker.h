@@ -0,0 +1,36 @@
+#pragma once
+
+#include "logs.h"
+
+#include "glm/glm.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+
+// Builds convex collision hulls from the alpha channel of an image, so colliders follow what a sprite actually
+// looks like instead of its rectangle. The hull always contains every opaque pixel, and is simplified down to a
+// vertex budget so support queries stay cheap. Results are cached on disk next to the image, as <image>.hull.json
+class HullBaker {
+public:
+	static unsigned char alpha_threshold; // Pixels with at least this much alpha are solid
+	static unsigned default_vertex_budget;
+
+	// The hull in the same space as a default Sprite mesh, the image covering -0.5 to 0.5 on both axes. Uses the cache
+	// if it's newer than the image and was baked with the same settings. Falls back to the full rectangle if the image can't be read
+	static std::vector<glm::vec2> load(const std::string& image_path, unsigned vertex_budget = default_vertex_budget);
+
+	// Bakes the hull and writes the cache, whether or not one exists
+	static std::vector<glm::vec2> bake(const std::string& image_path, unsigned vertex_budget = default_vertex_budget);
+
+	static std::string cachePath(const std::string& image_path);
+
+private:
+	static std::map<std::string, std::vector<glm::vec2>> baked; // Keyed by path and budget, so every ship of a class shares one bake
+
+	static bool readCache(const std::string& image_path, unsigned vertex_budget, std::vector<glm::vec2>* hull);
+	static void writeCache(const std::string& image_path, unsigned vertex_budget, const std::vector<glm::vec2>& hull);
+
+	static std::vector<glm::vec2> convexHull(std::vector<glm::vec2> points); // Counter clockwise, collinear points dropped
+	static void simplify(std::vector<glm::vec2>& hull, unsigned vertex_budget);
+};
@@ -15,4 +15,5 @@
 #include "game/ship.h"
 
 extern bool show_debug_menu;
-TileGrid gridTest();
\ No newline at end of file
+TileGrid gridTest();
+bool loadGameConfig(std::string path);
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Where objects made by newObj() and ObjFactory get their memory, instead of a trip to the global allocator for each
+// one. Every block starts with a header pointing back at the allocator it came from, so ObjectDeleter can give it
+// back without knowing the object's type. Neither allocator is thread safe, objects are made on the main thread
+class ObjAllocator {
+public:
+	virtual ~ObjAllocator() = default;
+
+	virtual void release(void* object) = 0; // Called after the object's destructor ran
+	unsigned live() const { return live_count; } // Blocks handed out and not released yet
+
+	static ObjAllocator* ownerOf(void* object);
+
+protected:
+	// Padded so whatever follows it is as aligned as operator new would make it
+	struct alignas(std::max_align_t) Header {
+		ObjAllocator* owner;
+	};
+
+	unsigned live_count = 0;
+
+	void* stamp(void* block); // Fills in the header, returns where the object goes
+};
+
+// Fixed size blocks for one type, carved out of chunks and kept on a free list once released. Chunks are never
+// given back, a pool stays as large as the most objects of its type that were alive at once
+class ObjPool : public ObjAllocator {
+public:
+	ObjPool(size_t object_size);
+
+	void* allocate();
+	void release(void* object) override;
+
+	// Every type has its own pool. They're never destroyed, objects owned by statics can outlive any static pool
+	template<class T>
+	static ObjPool& of() {
+		static ObjPool* pool = new ObjPool(sizeof(T));
+		return *pool;
+	}
+
+	static constexpr unsigned chunk_blocks = 64;
+
+private:
+	size_t block_size;
+	std::vector<std::unique_ptr<unsigned char[]>> chunks;
+	void* free_list = nullptr; // Each free block holds the next one where its header goes
+};
+
+// A bump allocator for everything a stage creates. Destroying an object runs its destructor but keeps the memory,
+// reset() frees all of it at once after the stage is unloaded. While a Scope is open, newObj() and ObjFactory
+// allocate from the arena instead of the pools
+class ObjArena {
+public:
+	ObjArena(size_t chunk_size = 1 << 20);
+	~ObjArena(); // If anything made from the arena is still alive its memory stays until the last of it is destroyed
+
+	ObjArena(const ObjArena&) = delete;
+	ObjArena& operator=(const ObjArena&) = delete;
+
+	void* allocate(size_t size);
+	unsigned live() const { return blocks->live(); }
+
+	// Frees every chunk but the first, and starts over at the front of it. Everything made from the arena has to be
+	// destroyed first, if anything's still alive this logs an error and keeps the memory rather than leave it dangling
+	void reset();
+
+	class Scope {
+	public:
+		Scope(ObjArena& arena);
+		~Scope();
+
+	private:
+		ObjArena* previous;
+	};
+
+	static ObjArena* current() { return current_arena; }
+
+private:
+	// The memory, and what the objects' headers point back at. It's apart from the arena so it can outlive it
+	class Blocks : public ObjAllocator {
+	public:
+		Blocks(size_t chunk_size) : chunk_size(chunk_size) {}
+
+		void* allocate(size_t size);
+		void release(void* object) override;
+		void reset();
+
+		bool orphaned = false; // The arena is gone, the last release() deletes this
+
+	private:
+		size_t chunk_size;
+		std::vector<std::unique_ptr<unsigned char[]>> chunks;
+		std::vector<std::unique_ptr<unsigned char[]>> large; // Allocations bigger than a chunk
+		size_t used = 0; // Bytes into the last chunk
+	};
+
+	Blocks* blocks;
+
+	inline static ObjArena* current_arena = nullptr;
+};
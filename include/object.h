@@ -2,6 +2,8 @@
 
 #include "utility.h"
 #include "logs.h"
+#include "symbol.h"
+#include "objAllocator.h"
 
 #include "json/json.h"
 
@@ -9,7 +11,10 @@
 #include <vector>
 #include <algorithm>
 #include <memory>
+#include <new>
 #include <streambuf>
+#include <functional>
+#include <map>
 
 struct ObjectCastException : public std::runtime_error {
     ObjectCastException(std::string type = "") : 
@@ -31,9 +36,32 @@ std::unique_ptr<Out> dynamic_unique_cast(std::unique_ptr<In> ptr) {
     throw std::bad_cast();
 }
 
+class Object;
+
+// Destroys an object made by newObj(), makeObj() or ObjFactory and hands its memory back to the pool or arena it came from
+struct ObjectDeleter {
+    void operator()(Object* o) const;
+};
+
+template<class T>
+using ObjPtr = std::unique_ptr<T, ObjectDeleter>;
+
+// Makes a T from the current stage arena if there is one, from T's pool otherwise
+template<class T, typename... Args>
+ObjPtr<T> makeObj(Args&&... args) {
+    static_assert(alignof(T) <= alignof(std::max_align_t), "Pools and arenas only align objects as much as operator new would");
+    void* memory = ObjArena::current() ? ObjArena::current()->allocate(sizeof(T)) : ObjPool::of<T>().allocate();
+    try {
+        return ObjPtr<T>(new(memory) T(std::forward<Args>(args)...));
+    } catch(...) {
+        ObjAllocator::ownerOf(memory)->release(memory);
+        throw;
+    }
+}
+
 class Object {
 public:
-    typedef std::unique_ptr<Object> ptr;
+    typedef ObjPtr<Object> ptr;
 
 	Object(std::string id);
 
@@ -41,7 +69,7 @@ public:
 
 	virtual ~Object();
 
-	std::string id;
+	Symbol id; // Shouldn't change while the object is a component, the parent's index wouldn't know
     std::string type;
     Object* parent = nullptr; // Raw pointer to the objects parent
 
@@ -49,28 +77,39 @@ public:
 
     // Moves an object from one parent into another (Destination << Input)
     template<class T>
-    void takeFromRef(std::unique_ptr<T>& o);
+    void takeFromRef(ObjPtr<T>& o);
 
     template<class T>
-    void take(std::unique_ptr<T> o);
+    void take(ObjPtr<T> o);
 
     void operator+=(Object::ptr &o); // Move an object from one parent to another
     void operator+=(std::vector<Object::ptr> &o_vec); // Move a vector of objects from one parent to another
 	void operator-=(Object::ptr &o); // Remove an object from an object's components
 
     Object::ptr& operator[](size_t index); // Operator that returns a component in this object's vector by index
-    Object::ptr& operator[](std::string id); // Operator that returns the component in this object's vector that matches the id
+    Object::ptr& operator[](Symbol id); // Operator that returns the component in this object's vector that matches the id
 
-    Object::ptr& get(std::string id); // Returns a refrence to an object component by matching the id
+    Object::ptr& get(Symbol id); // Returns a refrence to an object component by matching the id
+    Object* find(Symbol id); // Same as get(), but returns nullptr if there's no such component
 
     template<class T>
-    T& get(std::string id); // Equivalent to get(id)->as<T>() 
+    T& get(Symbol id); // Equivalent to get(id)->as<T>() 
+
+    unsigned componentsVersion() const { return components_version; } // Changes whenever a component is added or removed
     
     template<class T> T* as(); // Returns a pointer to the object as type T, if the object wasn't originally T, throws an ObjectCastException
+    template<class T> T* tryAs(); // Same as as(), but returns nullptr instead of throwing. A single mask test for types with an id, use it wherever a miss is expected
+    template<class T> bool is() { return tryAs<T>() != nullptr; }
+
+    uint16_t typeIndex() const { return type_index; } // The id of the most derived type that has one, 0 for plain Objects
     
     template<typename... Args> const void runup(std::function<void(Object*, Args...)>, Args... args); // Runs a function for parent recursively, working up the tree
     template<typename... Args> const void rundown(std::function<void(Object*, Args...)>, Args... args); // Runs a function for each child object recursively, branching for each component. Use lightly
 
+    // Called when an ancestor moved or this object changed parents, passes it on to the components. Object2d uses it
+    // to drop its cached world transform, objects that own Object2ds outside of components should pass it on to them too
+    virtual void invalidateTransforms();
+
 
     // A vector that holds objects with no parent, in practice shouldn't hold anything other than Level objects
     // static std::vector<Object::ptr> global;
@@ -78,6 +117,21 @@ public:
 protected:
 	std::vector<Object::ptr> components; // Vector of the objects sub-components
 	void createComponents(Json::Value items);
+	void componentsChanged() { components_version++; } // Call after changing components
+
+private:
+    unsigned components_version = 0;
+
+    // Open addressed by id, each slot holds a position in components + 1, or 0 if it's empty. Rebuilt by the first
+    // lookup after the components change
+    std::vector<uint32_t> component_slots;
+    unsigned indexed_version = ~0u;
+    void indexComponents();
+    int componentIndex(Symbol id); // -1 if there's no such component
+
+    friend struct ObjTypeTag;
+    uint64_t type_mask = 1; // One bit for each type with an id this object is, set as each constructor in the hierarchy runs. Bit 0 is Object
+    uint16_t type_index = 0;
 };
 
 // A class that registers, creates, and defines new Objects
@@ -96,21 +150,58 @@ public:
 
 	template<class T>
 	static bool const registerType(const char* name) {
-        std::function<Object::ptr(Json::Value)> create_f([](Json::Value j){ return std::make_unique<T>(j); });
+        std::function<Object::ptr(Json::Value)> create_f([](Json::Value j){ return makeObj<T>(j); });
         // std::function<T&(Object::ptr&)> cast_f([](Object::ptr& me){ return me->as<T&>(); }); // Haha I wish
 		getMap()->emplace(name, create_f);
 		return true;
 	}
+
+    // Type ids are handed out the first time a type asks for one, 0 is Object. Only the first 64 fit in an object's
+    // type mask, types past that still work but tryAs() falls back to dynamic_cast for them
+    static constexpr unsigned max_type_ids = 64;
+    template<class T> static uint16_t typeIndex() {
+        static const uint16_t index = newTypeIndex();
+        return index;
+    }
+    template<class T> static uint64_t typeBit() { // 0 if T's id doesn't fit in the mask
+        static const uint64_t bit = typeIndex<T>() < max_type_ids ? uint64_t(1) << typeIndex<T>() : 0;
+        return bit;
+    }
 	
 private:
+    static uint16_t newTypeIndex();
     static std::shared_ptr<map_type> getMap();
     inline static std::shared_ptr<map_type> typemap = nullptr; // The map of all the types and their functions
 };
 
 
+// Marks an object with its type's id when it's constructed, declared by OBJECT_TYPE_ID
+struct ObjTypeTag {
+    ObjTypeTag(Object* o, uint16_t index, uint64_t bit) {
+        o->type_mask |= bit;
+        o->type_index = index;
+    }
+
+    template<class T> static constexpr bool has() { return check<T>(0); } // Whether T itself declared an id, not just one of its bases
+
+private:
+    template<class T> static constexpr auto check(int) -> decltype(std::is_same<typename T::telabrium_type_self, T>::value) {
+        return std::is_same<typename T::telabrium_type_self, T>::value;
+    }
+    template<class T> static constexpr bool check(...) { return false; }
+};
+
+/* Gives the class a type id so tryAs() and is() don't need dynamic_cast, place inside class definition. Types registered
+* with REGISTER_OBJECT_TYPE already get one
+* telabrium_type_tag: a member, so every constructor of the class sets the bit without having to remember to */
+#define OBJECT_TYPE_ID(NAME) \
+    friend struct ObjTypeTag; \
+    using telabrium_type_self = NAME; \
+    ObjTypeTag telabrium_type_tag{this, ObjFactory::typeIndex<NAME>(), ObjFactory::typeBit<NAME>()}
+
 /* Creates a register function for the object and calls it, place inside class definition
 * telabrium_obj_reg: a trick using static initialization order to register the type before main()*/
-#define REGISTER_OBJECT_TYPE(NAME) inline static bool telabrium_obj_reg = ObjFactory::registerType<NAME>(#NAME)
+#define REGISTER_OBJECT_TYPE(NAME) OBJECT_TYPE_ID(NAME); inline static bool telabrium_obj_reg = ObjFactory::registerType<NAME>(#NAME)
 
 
 class BlankObject : public Object {
@@ -124,24 +215,28 @@ private:
 
 
 template<class T, typename... Args>
-static Object::ptr newObj(Args... args) {
-    return std::make_unique<T>(args...);
+static Object::ptr newObj(Args&&... args) {
+    return makeObj<T>(std::forward<Args>(args)...);
 }
 
 template<class T>
-void Object::takeFromRef(std::unique_ptr<T>& o) {
+void Object::takeFromRef(ObjPtr<T>& o) {
     o->parent = this;
+    o->invalidateTransforms();
     components.push_back(std::move(o));
+    componentsChanged();
 }
 
 template<class T>
-void Object::take(std::unique_ptr<T> o) {
+void Object::take(ObjPtr<T> o) {
     o->parent = this;
-    components.push_back(std::move(dynamic_unique_cast<T, Object>(std::move(o))));
+    o->invalidateTransforms();
+    components.push_back(std::move(o));
+    componentsChanged();
 }
 
 template<class T> T* Object::as() {
-	T* out = dynamic_cast<T*>(this); // Attempt to cast this to T
+	T* out = tryAs<T>(); // Attempt to cast this to T
 	if(out) { // If the object wasn't originally T, it will return a nullptr
 		return out;
 	} else {
@@ -149,11 +244,45 @@ template<class T> T* Object::as() {
 	}
 }
 
+template<class T> T* Object::tryAs() {
+    if constexpr(std::is_base_of<T, Object>::value) {
+        return this;
+    } else if constexpr(ObjTypeTag::has<T>()) {
+        if(uint64_t bit = ObjFactory::typeBit<T>())
+            return (type_mask & bit) ? static_cast<T*>(this) : nullptr;
+    }
+    return dynamic_cast<T*>(this); // Types without an id, or past the mask
+}
+
 template<class T>
-T& Object::get(std::string id) {
+T& Object::get(Symbol id) {
     return *get(id)->as<T>();
 }
 
+// A component that's looked up by id once and then kept, until the parent's components change. Cheaper than calling
+// get() every frame. Throws an ObjectMissingException, like get(), if the component isn't there
+template<class T>
+class ComponentRef {
+public:
+    ComponentRef(Object* parent, Symbol id) : parent(parent), id(id) {}
+
+    T& get() {
+        if(!cached || version != parent->componentsVersion()) {
+            cached = &parent->get<T>(id);
+            version = parent->componentsVersion();
+        }
+        return *cached;
+    }
+    T& operator*() { return get(); }
+    T* operator->() { return &get(); }
+
+private:
+    Object* parent;
+    Symbol id;
+    T* cached = nullptr;
+    unsigned version = 0;
+};
+
 // Testing only
 // auto Object::get(std::string id) -> decltype(getType(id->type)) {
     
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "object.h"
+#include "transformStore.h"
 
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
@@ -43,16 +44,41 @@ public:
 	glm::vec2 getWorldScl() const;
 	Object2d& setWorldScl(glm::vec2);
 
+	// Both are cached, and only rebuilt after the object or one of its ancestors moves
 	glm::mat4 getTransform() const;
 	glm::mat4 getWorldTransform() const;
+	Affine2d getAffine() const; // The same transforms, without widening them to a glm::mat4
+	Affine2d getWorldAffine() const;
 	Object2d& setTransform(glm::mat4);
 	Object2d& setWorldTransform(glm::mat4);
 	Object2d& transformBy(glm::mat4);
 
+	// The transform blended between the last two simulation ticks, for drawing. Matches the
+	// regular transform when nothing runs on a Scheduler
+	glm::vec2 getRenderPos() const;
+	float getRenderRot() const;
+	glm::mat4 getRenderTransform() const;
+	Affine2d getRenderAffine() const;
+
+	// Set by Scheduler. Changes made during a tick are blended in by tick_alpha when rendering,
+	// changes made outside of one show up immediately
+	static void beginTick();
+	static void endTick();
+	static float tick_alpha;
+
 	// Directional vectors
 	glm::vec2 up();
 	glm::vec2 right();
 
+	void invalidateTransforms() override; // Drops the cached world transform here and in everything below
+
+	// Every Object2d's transforms live in one packed store. updateTransforms() brings all of the world transforms up
+	// to date in a single pass, parents first, after which they can be read straight out of the store by index
+	static void updateTransforms();
+	static void updateRenderTransforms(); // The same for render transforms, blended by tick_alpha
+	static const TransformStore& getTransforms();
+	unsigned getTransformIndex() const;
+
 protected:
 	// Default values for spatial values
 	static constexpr glm::vec2 default_pos = glm::vec2(0);
@@ -60,9 +86,37 @@ protected:
 	static constexpr glm::vec2 default_scl = glm::vec2(1);
 
 private:
+	OBJECT_TYPE_ID(Object2d);
+
 	glm::vec2 position;
 	float rotation;
 	glm::vec2 scale;
+
+	// The cached transforms and their dirty flags are in here. A world transform is never clean while an ancestor's
+	// is dirty, so a dirty object's descendants are all dirty too
+	TransformStore::Handle transform_handle;
+	static TransformStore transforms;
+	friend class TransformStore;
+
+	// The transform from before the tick it last changed in
+	glm::vec2 last_position;
+	float last_rotation;
+	glm::vec2 last_scale;
+	unsigned last_tick = 0;
+
+	static unsigned tick;
+	static bool ticking;
+
+	void rememberLast(); // Saves the transform the first time it changes in a tick
+	glm::vec2 getBlendedPos() const;
+	float getBlendedRot() const;
+	glm::vec2 getBlendedScl() const;
+	Affine2d getBlendedAffine() const;
+
+	void transformSet(); // Called by the setters after changing position, rotation or scale
+	void invalidateWorld();
+	Object2d* parent2d() const; // The closest ancestor that's an Object2d, objects in between are skipped
+	Affine2d composeTransform(glm::vec2 pos, float rot, glm::vec2 scl) const;
 };
 
 float degreeFromMat4(glm::mat4 in);
@@ -2,26 +2,48 @@
 
 #include "object2d.h"
 #include "collider.h"
+#include "bodyStore.h"
 
 #include "glm/glm.hpp"
 #include "glm/gtx/vector_angle.hpp"
 
 #include <cmath>
 
+// The body's state lives in a shared BodyStore so the whole world can be integrated in one pass,
+// the object itself only keeps a handle to it
 class Rigidbody2d : public Object {
 public:
-	Rigidbody2d(std::string id, std::unique_ptr<Collider> collider, float mass = 1);
+	Rigidbody2d(std::string id, ObjPtr<Collider> collider, float mass = 1);
 	Rigidbody2d(std::string id, std::vector<glm::vec2> mesh, float mass = 1);
+	Rigidbody2d(Json::Value j); // "mass", a "radius" or a list of [x, y] "points", "fast", and "collision" for Collider::loadFilter()
 	~Rigidbody2d();
 
-	std::unique_ptr<Collider> collider;
-	glm::vec2 velocity = glm::vec2(0);
-	float angular_velocity = 0;
+	ObjPtr<Collider> collider;
+
+	static float default_radius; // For a body loaded from JSON without a usable shape
+	static float sweep_contact_depth; // How far a fast body moves past its time of impact, so the narrowphase sees the contact
+
+	// A body sleeps once it and everything touching it have been slower than these for sleep_delay seconds.
+	// Sleeping bodies aren't integrated or tested against each other. Forces, displacement, setting the
+	// velocity and contacts with awake bodies wake them. Moving a sleeping body's object directly isn't noticed, wake() it first
+	static bool sleeping_enabled;
+	static float sleep_velocity; // Units per second
+	static float sleep_angular_velocity; // Degrees per second
+	static float sleep_delay;
 
 	float getMass() const;
+	float getInverseMass() const;
+	float getInverseInertia() const;
 	glm::vec2 getNetForce() const;
+	glm::vec2 getVelocity() const;
+	float getAngularVelocity() const;
+	bool isFast() const;
+	BodyStore::Handle getHandle() const;
 
 	float setMass(float mass);
+	void setVelocity(glm::vec2 velocity);
+	void setAngularVelocity(float angular_velocity);
+	void setFast(bool fast); // Fast bodies sweep their movement each step so they can't tunnel through thin colliders, it costs a few GJK tests per step
 	
 	void teleport_w(glm::vec2 position);
 	void displace_w(glm::vec2 offset);
@@ -29,17 +51,35 @@ public:
 	
 	void applyForce(glm::vec2 force, glm::vec2 pos = glm::vec2(0));
 	void applyTorque(float torque);
+	void applyImpulse(glm::vec2 impulse, glm::vec2 point); // Changes the velocity right away, point is in world space
 
-	static void collide(glm::vec2 resolution_vec, Rigidbody2d* b1, Rigidbody2d* b2, float deltaTime, float elastic = 0);
+	bool isAwake() const;
+	void wake();
+	void sleep();
 
-	void update(float deltaTime);
 	static void updateAll(float deltaTime);
+	static void updateIslands(const std::vector<std::pair<Rigidbody2d*, Rigidbody2d*>>& contacts); // Sleeps or wakes each group of touching bodies as one
+
+	static const BodyStore& getStore();
+
+	void invalidateTransforms() override; // The collider isn't a component, so it has to be passed on by hand
 
 private:
 	float mass;
-	float moment_of_inertia;
-	glm::vec2 net_force = glm::vec2(0);
-	float net_torque = 0;
+	BodyStore::Handle handle;
+
+	Object2d* target = nullptr; // The object this body moves, looked up again whenever the parent changes
+	Object* target_parent = nullptr;
+	Object2d* getTarget();
+
+	void sweepStep(unsigned index); // Cuts a fast body's step short at its first hit
+	void moveTarget(unsigned index); // Applies the step to the object
+
+	static BodyStore bodies;
+	REGISTER_OBJECT_TYPE(Rigidbody2d);
 
-	static std::vector<Rigidbody2d*> bodies;
-};
\ No newline at end of file
+	static std::vector<unsigned> islands; // Union-find parents, indexed like bodies. Only valid during updateIslands()
+	static std::vector<float> island_sleep_time; // Reused by updateIslands()
+	static std::vector<Rigidbody2d*> island_changes; // Bodies updateIslands() is about to sleep or wake
+	static unsigned findIsland(unsigned index);
+};
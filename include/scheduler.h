@@ -0,0 +1,25 @@
+#pragma once
+
+#include <functional>
+
+// Runs the simulation in fixed ticks no matter how long frames take. Time left over from a frame carries
+// into the next one, and objects are drawn blended between the last two ticks so motion stays smooth
+class Scheduler {
+public:
+	Scheduler(float tick_rate = 60, unsigned max_ticks = 5);
+
+	float tick_length; // Seconds per tick
+	unsigned max_ticks; // The most ticks run in one frame. Time past that is dropped, so one slow frame can't snowball into more
+
+	// Runs tick(tick_length) as many times as frame_time allows, returns how many ran
+	unsigned advance(float frame_time, std::function<void(float)> tick);
+
+	float getAlpha() const; // How far the frame is between the last tick and the next one, 0 to 1
+	unsigned getTickCount() const;
+	unsigned getDroppedTicks() const; // Ticks skipped because of max_ticks, since the start
+
+private:
+	float accumulator = 0;
+	unsigned tick_count = 0;
+	unsigned dropped_ticks = 0;
+};
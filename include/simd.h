@@ -0,0 +1,36 @@
+#pragma once
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// The few vector operations the packed stores need, as wide as the target allows
+namespace simd {
+#if defined(__AVX__)
+	typedef __m256 floats;
+	constexpr unsigned width = 8;
+
+	inline floats load(const float* p) { return _mm256_loadu_ps(p); }
+	inline void store(float* p, floats v) { _mm256_storeu_ps(p, v); }
+	inline floats splat(float f) { return _mm256_set1_ps(f); }
+	inline floats add(floats a, floats b) { return _mm256_add_ps(a, b); }
+	inline floats mul(floats a, floats b) { return _mm256_mul_ps(a, b); }
+	inline floats both(floats a, floats b) { return _mm256_and_ps(a, b); }
+	inline floats clearWhere(floats mask, floats v) { return _mm256_andnot_ps(mask, v); }
+	inline floats less(floats a, floats b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline floats absolute(floats v) { return _mm256_andnot_ps(_mm256_set1_ps(-0.f), v); }
+#elif defined(__SSE2__)
+	typedef __m128 floats;
+	constexpr unsigned width = 4;
+
+	inline floats load(const float* p) { return _mm_loadu_ps(p); }
+	inline void store(float* p, floats v) { _mm_storeu_ps(p, v); }
+	inline floats splat(float f) { return _mm_set1_ps(f); }
+	inline floats add(floats a, floats b) { return _mm_add_ps(a, b); }
+	inline floats mul(floats a, floats b) { return _mm_mul_ps(a, b); }
+	inline floats both(floats a, floats b) { return _mm_and_ps(a, b); }
+	inline floats clearWhere(floats mask, floats v) { return _mm_andnot_ps(mask, v); }
+	inline floats less(floats a, floats b) { return _mm_cmplt_ps(a, b); }
+	inline floats absolute(floats v) { return _mm_andnot_ps(_mm_set1_ps(-0.f), v); }
+#endif
+}
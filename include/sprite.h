@@ -34,6 +34,9 @@ protected:
 	
 	static const char* default_shader_path_vert;
 	static const char* default_shader_path_frag;
+
+private:
+	OBJECT_TYPE_ID(Sprite);
 };
 
 class TiledSprite : public Sprite {
@@ -66,6 +69,7 @@ private:
 	void init_IBO(glm::vec2 offset_size, glm::ivec2 tiling_range);
 
 	static const char* tiled_shader_path_vert;
+	OBJECT_TYPE_ID(TiledSprite);
 };
 
 class AnimSprite : public Sprite {
@@ -86,4 +90,5 @@ private:
 	unsigned frame = 0;
 
 	void updateTexture();
+	OBJECT_TYPE_ID(AnimSprite);
 };
\ No newline at end of file
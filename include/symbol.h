@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <functional>
+
+// A string interned into one global table, so copying, comparing and hashing it are integer operations. Object
+// ids are Symbols. Interning isn't thread safe, make new ones on the main thread
+class Symbol {
+public:
+	Symbol() = default; // The empty string
+	Symbol(std::string_view s);
+	Symbol(const std::string& s) : Symbol(std::string_view(s)) {}
+	Symbol(const char* s) : Symbol(std::string_view(s)) {}
+
+	const std::string& str() const;
+	operator const std::string&() const { return str(); }
+	uint32_t value() const { return index; }
+
+	bool operator==(Symbol o) const { return index == o.index; }
+	bool operator!=(Symbol o) const { return index != o.index; }
+
+private:
+	uint32_t index = 0;
+};
+
+namespace std {
+	template<>
+	struct hash<Symbol> {
+		size_t operator()(Symbol s) const { return s.value(); }
+	};
+}
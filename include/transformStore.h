@@ -0,0 +1,112 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <vector>
+#include <cstdint>
+
+class Object2d;
+
+// The part of a glm::mat4 a 2d object actually uses. (a, b) and (c, d) are the x and y axes, (tx, ty) the translation.
+// z is the object layer, which adds up through the hierarchy the same way translation does
+struct Affine2d {
+	float a = 1, b = 0, c = 0, d = 1;
+	float tx = 0, ty = 0;
+	float z = 0;
+
+	// Scales, then rotates (degrees), then translates, like translate * rotate * scale
+	static Affine2d compose(glm::vec2 pos, float rot, glm::vec2 scl, float z);
+
+	// Same results as the glm::mat4 product, parent * child
+	Affine2d operator*(const Affine2d& o) const {
+		Affine2d out;
+		out.a = a * o.a + c * o.b;
+		out.b = b * o.a + d * o.b;
+		out.c = a * o.c + c * o.d;
+		out.d = b * o.c + d * o.d;
+		out.tx = a * o.tx + c * o.ty + tx;
+		out.ty = b * o.tx + d * o.ty + ty;
+		out.z = o.z + z;
+		return out;
+	}
+
+	glm::vec2 operator*(glm::vec2 point) const {
+		return glm::vec2(a * point.x + c * point.y + tx, b * point.x + d * point.y + ty);
+	}
+
+	bool operator==(const Affine2d& o) const {
+		return a == o.a && b == o.b && c == o.c && d == o.d && tx == o.tx && ty == o.ty && z == o.z;
+	}
+	bool operator!=(const Affine2d& o) const { return !(*this == o); }
+
+	glm::mat4 toMat4() const {
+		glm::mat4 m(1);
+		m[0][0] = a;  m[0][1] = b;
+		m[1][0] = c;  m[1][1] = d;
+		m[3][0] = tx; m[3][1] = ty; m[3][2] = z;
+		return m;
+	}
+};
+
+// Transforms for every Object2d, packed one array per field and kept in topological order, parents before their
+// children, so one forward pass updates all of them. Everything on the same depth is independent, so each depth
+// runs through SIMD registers. Objects hold a handle to their entry, entries move when the order is rebuilt
+class TransformStore {
+public:
+	typedef unsigned Handle;
+
+	struct Affines { // One array per field of Affine2d
+		std::vector<float> a, b, c, d, tx, ty, z;
+
+		Affine2d get(unsigned i) const { return { a[i], b[i], c[i], d[i], tx[i], ty[i], z[i] }; }
+		void set(unsigned i, const Affine2d& t) {
+			a[i] = t.a; b[i] = t.b; c[i] = t.c; d[i] = t.d;
+			tx[i] = t.tx; ty[i] = t.ty; z[i] = t.z;
+		}
+	};
+
+	Handle add(Object2d* owner);
+	void remove(Handle handle);
+
+	unsigned index(Handle handle) const { return handle_to_index[handle]; }
+	unsigned size() const { return owners.size(); }
+
+	// Indexed by index(handle)
+	Affines local, world;
+	Affines render; // World transforms blended between the last two ticks, only filled in by updateRender()
+	std::vector<int> parent; // The closest Object2d ancestor's index, -1 for roots. Only valid while inOrder()
+	std::vector<uint8_t> local_dirty, world_dirty;
+	std::vector<uint8_t> blending; // Moved during the latest tick, so its render transform isn't its world transform
+	std::vector<Object2d*> owners;
+
+	bool inOrder() const { return !order_dirty; }
+	void hierarchyChanged() { order_dirty = true; render_valid = false; } // Something was added, removed or changed parents
+	Object2d* parentOf(unsigned index) const { return parent[index] == -1 ? nullptr : owners[parent[index]]; }
+
+	void invalidate(unsigned index) { world_dirty[index] = 1; world_changed = true; render_valid = false; }
+	void blend(unsigned index) { blending[index] = 1; render_valid = false; }
+	void stopBlending(); // Called when a new tick starts
+
+	void update(); // Rebuilds the order if it changed, then every world transform if any are dirty
+	void updateRender(float alpha); // update(), then every render transform blended by alpha
+	bool renderCurrent(float alpha) const { return render_valid && render_alpha == alpha; }
+
+private:
+	std::vector<unsigned> handle_to_index;
+	std::vector<Handle> index_to_handle;
+	std::vector<Handle> free_handles;
+
+	bool order_dirty = false;
+	bool world_changed = false;
+	bool render_valid = false;
+	float render_alpha = 0;
+
+	std::vector<unsigned> levels; // Where each depth starts, with size() on the end. Roots are the first level
+	Affines render_local; // Reused by updateRender()
+
+	void sort();
+	void propagate(const Affines& locals, Affines& out); // out = out[parent] * locals, level by level
+
+	template<typename F>
+	void forEachArray(F func); // Calls func on every float array that's indexed like owners
+};
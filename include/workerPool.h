@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of threads for splitting up loops. The calling thread works through
+// batches too, so a pool without any threads just runs everything in place. The threads
+// aren't started until the first parallelFor(), so a static pool costs nothing until it's used
+class WorkerPool {
+public:
+	WorkerPool(unsigned thread_count = defaultThreadCount());
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Calls task(begin, end, worker) for batches covering [0, count), and returns once they're all done.
+	// No two batches running at the same time share a worker index, so it can pick a per-thread buffer
+	void parallelFor(unsigned count, unsigned batch_size, std::function<void(unsigned, unsigned, unsigned)> task);
+
+	void setThreadCount(unsigned thread_count); // Must not be called while a job is running
+	unsigned getWorkerCount() const; // The threads plus the calling one, whether or not they've started yet
+
+	static unsigned defaultThreadCount(); // One less than the number of cores
+
+private:
+	std::vector<std::thread> threads;
+	unsigned thread_count; // How many threads to start when they're first needed
+	bool started = false;
+	std::mutex mutex;
+	std::condition_variable work_ready;
+	std::condition_variable work_done;
+
+	// The current job, only written while every thread is waiting
+	std::function<void(unsigned, unsigned, unsigned)> task;
+	unsigned count = 0;
+	unsigned batch_size = 1;
+	std::atomic<unsigned> next_batch{0};
+
+	unsigned busy = 0; // Threads that haven't finished the current job
+	unsigned generation = 0; // Counts jobs, so waiting threads can tell there's a new one
+	bool stopping = false;
+
+	void startThreads(unsigned thread_count);
+	void stopThreads();
+	void threadMain(unsigned worker, unsigned seen);
+	void runBatches(unsigned worker);
+};
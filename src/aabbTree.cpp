@@ -0,0 +1,299 @@
+#include "aabbTree.h"
+
+AABBTree::AABBTree(float margin) : margin(margin) {}
+
+int AABBTree::allocateNode() {
+	if(free_list == -1) {
+		nodes.emplace_back();
+		return nodes.size() - 1;
+	}
+
+	int node = free_list;
+	free_list = nodes[node].parent;
+	nodes[node] = Node();
+	return node;
+}
+
+void AABBTree::freeNode(int node) {
+	nodes[node].parent = free_list;
+	nodes[node].height = -1;
+	nodes[node].collider = nullptr;
+	free_list = node;
+}
+
+int AABBTree::createProxy(const BoundingBox& box, Collider* collider) {
+	int proxy = allocateNode();
+
+	glm::vec2 fat(margin);
+	nodes[proxy].box = BoundingBox(box.lower_left - fat, box.upper_right + fat);
+	nodes[proxy].collider = collider;
+	nodes[proxy].height = 0;
+
+	insertLeaf(proxy);
+	proxy_count++;
+	return proxy;
+}
+
+void AABBTree::destroyProxy(int proxy) {
+	removeLeaf(proxy);
+	freeNode(proxy);
+	proxy_count--;
+}
+
+bool AABBTree::moveProxy(int proxy, const BoundingBox& box, glm::vec2 displacement) {
+	if(nodes[proxy].box.contains(box))
+		return false; // Still inside the fat box, nothing to do
+
+	removeLeaf(proxy);
+
+	// Fatten the box, and stretch it in the direction it's moving to predict where it will be
+	glm::vec2 fat(margin);
+	BoundingBox fat_box(box.lower_left - fat, box.upper_right + fat);
+
+	glm::vec2 d = displacement * displacement_multiplier;
+	if(d.x < 0) fat_box.lower_left.x += d.x;
+	else fat_box.upper_right.x += d.x;
+	if(d.y < 0) fat_box.lower_left.y += d.y;
+	else fat_box.upper_right.y += d.y;
+
+	nodes[proxy].box = fat_box;
+	insertLeaf(proxy);
+	return true;
+}
+
+Collider* AABBTree::getCollider(int proxy) const {
+	return nodes[proxy].collider;
+}
+
+const BoundingBox& AABBTree::getFatBox(int proxy) const {
+	return nodes[proxy].box;
+}
+
+int AABBTree::getHeight() const {
+	if(root == -1)
+		return 0;
+	return nodes[root].height;
+}
+
+unsigned AABBTree::getProxyCount() const {
+	return proxy_count;
+}
+
+void AABBTree::insertLeaf(int leaf) {
+	if(root == -1) {
+		root = leaf;
+		nodes[root].parent = -1;
+		return;
+	}
+
+	// Walk down the tree to find the best sibling for the new leaf. At each node, compare the cost of
+	// pairing the leaf with this node against the cheapest possible cost of descending into a child
+	BoundingBox leaf_box = nodes[leaf].box;
+	int index = root;
+	while(!nodes[index].isLeaf()) {
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		float area = nodes[index].box.getPerimeter();
+		float combined_area = BoundingBox::merge(nodes[index].box, leaf_box).getPerimeter();
+
+		float cost = 2.f * combined_area; // Cost of creating a new parent for this node and the leaf
+		float inheritance_cost = 2.f * (combined_area - area); // Minimum cost of pushing the leaf further down
+
+		auto descendCost = [&](int child) {
+			float merged = BoundingBox::merge(leaf_box, nodes[child].box).getPerimeter();
+			if(nodes[child].isLeaf())
+				return merged + inheritance_cost;
+			return (merged - nodes[child].box.getPerimeter()) + inheritance_cost;
+		};
+
+		float cost1 = descendCost(child1);
+		float cost2 = descendCost(child2);
+
+		if(cost < cost1 && cost < cost2)
+			break;
+
+		index = (cost1 < cost2) ? child1 : child2;
+	}
+	int sibling = index;
+
+	// Create a new parent for the sibling and the leaf
+	int old_parent = nodes[sibling].parent;
+	int new_parent = allocateNode();
+	nodes[new_parent].parent = old_parent;
+	nodes[new_parent].box = BoundingBox::merge(leaf_box, nodes[sibling].box);
+	nodes[new_parent].height = nodes[sibling].height + 1;
+	nodes[new_parent].child1 = sibling;
+	nodes[new_parent].child2 = leaf;
+	nodes[sibling].parent = new_parent;
+	nodes[leaf].parent = new_parent;
+
+	if(old_parent != -1) {
+		if(nodes[old_parent].child1 == sibling)
+			nodes[old_parent].child1 = new_parent;
+		else
+			nodes[old_parent].child2 = new_parent;
+	} else {
+		root = new_parent;
+	}
+
+	// Walk back up the tree fixing heights and boxes
+	index = nodes[leaf].parent;
+	while(index != -1) {
+		index = balance(index);
+
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+		nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+		nodes[index].box = BoundingBox::merge(nodes[child1].box, nodes[child2].box);
+
+		index = nodes[index].parent;
+	}
+}
+
+void AABBTree::removeLeaf(int leaf) {
+	if(leaf == root) {
+		root = -1;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grand_parent = nodes[parent].parent;
+	int sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+	if(grand_parent != -1) {
+		// Destroy the parent and connect the sibling to the grandparent
+		if(nodes[grand_parent].child1 == parent)
+			nodes[grand_parent].child1 = sibling;
+		else
+			nodes[grand_parent].child2 = sibling;
+		nodes[sibling].parent = grand_parent;
+		freeNode(parent);
+
+		// Adjust ancestor bounds
+		int index = grand_parent;
+		while(index != -1) {
+			index = balance(index);
+
+			int child1 = nodes[index].child1;
+			int child2 = nodes[index].child2;
+			nodes[index].box = BoundingBox::merge(nodes[child1].box, nodes[child2].box);
+			nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+
+			index = nodes[index].parent;
+		}
+	} else {
+		root = sibling;
+		nodes[sibling].parent = -1;
+		freeNode(parent);
+	}
+}
+
+// Performs a left or right rotation if node A is imbalanced, returns the new root of this subtree
+// A's children are B and C, B's children are D and E, and C's children are F and G
+int AABBTree::balance(int a_id) {
+	Node& a = nodes[a_id];
+	if(a.isLeaf() || a.height < 2)
+		return a_id;
+
+	int b_id = a.child1;
+	int c_id = a.child2;
+	Node& b = nodes[b_id];
+	Node& c = nodes[c_id];
+
+	int imbalance = c.height - b.height;
+
+	// Rotate C up
+	if(imbalance > 1) {
+		int f_id = c.child1;
+		int g_id = c.child2;
+		Node& f = nodes[f_id];
+		Node& g = nodes[g_id];
+
+		// Swap A and C
+		c.child1 = a_id;
+		c.parent = a.parent;
+		a.parent = c_id;
+
+		// A's old parent should point to C
+		if(c.parent != -1) {
+			if(nodes[c.parent].child1 == a_id)
+				nodes[c.parent].child1 = c_id;
+			else
+				nodes[c.parent].child2 = c_id;
+		} else {
+			root = c_id;
+		}
+
+		// Rotate the taller of F and G up with C
+		if(f.height > g.height) {
+			c.child2 = f_id;
+			a.child2 = g_id;
+			g.parent = a_id;
+			a.box = BoundingBox::merge(b.box, g.box);
+			c.box = BoundingBox::merge(a.box, f.box);
+
+			a.height = 1 + std::max(b.height, g.height);
+			c.height = 1 + std::max(a.height, f.height);
+		} else {
+			c.child2 = g_id;
+			a.child2 = f_id;
+			f.parent = a_id;
+			a.box = BoundingBox::merge(b.box, f.box);
+			c.box = BoundingBox::merge(a.box, g.box);
+
+			a.height = 1 + std::max(b.height, f.height);
+			c.height = 1 + std::max(a.height, g.height);
+		}
+
+		return c_id;
+	}
+
+	// Rotate B up
+	if(imbalance < -1) {
+		int d_id = b.child1;
+		int e_id = b.child2;
+		Node& d = nodes[d_id];
+		Node& e = nodes[e_id];
+
+		// Swap A and B
+		b.child1 = a_id;
+		b.parent = a.parent;
+		a.parent = b_id;
+
+		// A's old parent should point to B
+		if(b.parent != -1) {
+			if(nodes[b.parent].child1 == a_id)
+				nodes[b.parent].child1 = b_id;
+			else
+				nodes[b.parent].child2 = b_id;
+		} else {
+			root = b_id;
+		}
+
+		// Rotate the taller of D and E up with B
+		if(d.height > e.height) {
+			b.child2 = d_id;
+			a.child1 = e_id;
+			e.parent = a_id;
+			a.box = BoundingBox::merge(c.box, e.box);
+			b.box = BoundingBox::merge(a.box, d.box);
+
+			a.height = 1 + std::max(c.height, e.height);
+			b.height = 1 + std::max(a.height, d.height);
+		} else {
+			b.child2 = e_id;
+			a.child1 = d_id;
+			d.parent = a_id;
+			a.box = BoundingBox::merge(c.box, d.box);
+			b.box = BoundingBox::merge(a.box, e.box);
+
+			a.height = 1 + std::max(c.height, d.height);
+			b.height = 1 + std::max(a.height, e.height);
+		}
+
+		return b_id;
+	}
+
+	return a_id;
+}
@@ -0,0 +1,175 @@
+#include "bodyStore.h"
+#include "simd.h"
+
+#include <cmath>
+#include <utility>
+
+BodyStore::Handle BodyStore::add(Rigidbody2d* owner) {
+	Handle handle;
+	if(free_handles.empty()) {
+		handle = handle_to_index.size();
+		handle_to_index.push_back(0);
+	} else {
+		handle = free_handles.back();
+		free_handles.pop_back();
+	}
+
+	handle_to_index[handle] = owners.size();
+	index_to_handle.push_back(handle);
+	owners.push_back(owner);
+	fast.push_back(0);
+	forEachArray([](std::vector<float>& array) {
+		array.push_back(0);
+	});
+
+	// New bodies start awake
+	swapEntries(awake_count, owners.size() - 1);
+	awake_count++;
+
+	return handle;
+}
+
+// Moves the last entry into the removed one's place, so the arrays stay packed
+void BodyStore::remove(Handle handle) {
+	setAwake(handle, false); // Keeps the awake entries together, the last entry is asleep too now
+	unsigned index = handle_to_index[handle];
+	unsigned last = owners.size() - 1;
+
+	if(index != last) {
+		Handle moved = index_to_handle[last];
+		handle_to_index[moved] = index;
+		index_to_handle[index] = moved;
+
+		owners[index] = owners[last];
+		fast[index] = fast[last];
+		forEachArray([index, last](std::vector<float>& array) {
+			array[index] = array[last];
+		});
+	}
+
+	index_to_handle.pop_back();
+	owners.pop_back();
+	fast.pop_back();
+	forEachArray([](std::vector<float>& array) {
+		array.pop_back();
+	});
+
+	free_handles.push_back(handle);
+}
+
+// Swaps the entry with the first sleeping one or the last awake one, and moves the boundary past it
+void BodyStore::setAwake(Handle handle, bool awake) {
+	unsigned index = handle_to_index[handle];
+	if(awake && index >= awake_count) {
+		swapEntries(index, awake_count);
+		awake_count++;
+	} else if(!awake && index < awake_count) {
+		awake_count--;
+		swapEntries(index, awake_count);
+	}
+}
+
+void BodyStore::swapEntries(unsigned a, unsigned b) {
+	if(a == b)
+		return;
+
+	std::swap(index_to_handle[a], index_to_handle[b]);
+	handle_to_index[index_to_handle[a]] = a;
+	handle_to_index[index_to_handle[b]] = b;
+
+	std::swap(owners[a], owners[b]);
+	std::swap(fast[a], fast[b]);
+	forEachArray([a, b](std::vector<float>& array) {
+		std::swap(array[a], array[b]);
+	});
+}
+
+template<typename F>
+void BodyStore::forEachArray(F func) {
+	for(std::vector<float>* array : {
+		&pos_x, &pos_y, &rot,
+		&vel_x, &vel_y, &ang_vel,
+		&force_x, &force_y, &torque,
+		&inv_mass, &inv_moi,
+		&step_x, &step_y, &step_rot,
+		&sleep_time
+	}) {
+		func(*array);
+	}
+}
+
+void BodyStore::integrate(float deltaTime, float sleep_velocity, float sleep_angular_velocity) {
+	unsigned count = awake_count; // Sleeping bodies don't move, their velocities and forces were cleared when they fell asleep
+	unsigned i = 0;
+
+#if defined(__AVX__) || defined(__SSE2__)
+	const simd::floats dt = simd::splat(deltaTime);
+	const simd::floats zero = simd::splat(0);
+	const simd::floats rest_v = simd::splat(rest_velocity);
+	const simd::floats rest_av = simd::splat(rest_angular_velocity);
+	const simd::floats sleep_v2 = simd::splat(sleep_velocity * sleep_velocity);
+	const simd::floats sleep_av = simd::splat(sleep_angular_velocity);
+
+	for(; i + simd::width <= count; i += simd::width) {
+		simd::floats vx = simd::load(&vel_x[i]);
+		simd::floats vy = simd::load(&vel_y[i]);
+		simd::floats av = simd::load(&ang_vel[i]);
+
+		// Judged by the velocity the solver left the body with, before this step's forces. A body resting under
+		// gravity gains g * deltaTime here every step and loses it again to its contacts
+		simd::floats still = simd::both(simd::less(simd::add(simd::mul(vx, vx), simd::mul(vy, vy)), sleep_v2), simd::less(simd::absolute(av), sleep_av));
+		simd::store(&sleep_time[i], simd::both(still, simd::add(simd::load(&sleep_time[i]), dt)));
+
+		vx = simd::add(vx, simd::mul(simd::mul(simd::load(&force_x[i]), simd::load(&inv_mass[i])), dt));
+		vy = simd::add(vy, simd::mul(simd::mul(simd::load(&force_y[i]), simd::load(&inv_mass[i])), dt));
+		av = simd::add(av, simd::mul(simd::mul(simd::load(&torque[i]), simd::load(&inv_moi[i])), dt));
+
+		vx = simd::clearWhere(simd::less(simd::absolute(vx), rest_v), vx);
+		vy = simd::clearWhere(simd::less(simd::absolute(vy), rest_v), vy);
+		av = simd::clearWhere(simd::less(simd::absolute(av), rest_av), av);
+
+		simd::floats sx = simd::mul(vx, dt);
+		simd::floats sy = simd::mul(vy, dt);
+		simd::floats sr = simd::mul(av, dt);
+
+		simd::store(&vel_x[i], vx);
+		simd::store(&vel_y[i], vy);
+		simd::store(&ang_vel[i], av);
+		simd::store(&step_x[i], sx);
+		simd::store(&step_y[i], sy);
+		simd::store(&step_rot[i], sr);
+		simd::store(&pos_x[i], simd::add(simd::load(&pos_x[i]), sx));
+		simd::store(&pos_y[i], simd::add(simd::load(&pos_y[i]), sy));
+		simd::store(&rot[i], simd::add(simd::load(&rot[i]), sr));
+		simd::store(&force_x[i], zero);
+		simd::store(&force_y[i], zero);
+		simd::store(&torque[i], zero);
+	}
+#endif
+
+	// Whatever didn't fill a whole register
+	for(; i < count; i++) {
+		bool still = vel_x[i] * vel_x[i] + vel_y[i] * vel_y[i] < sleep_velocity * sleep_velocity &&
+		             std::fabs(ang_vel[i]) < sleep_angular_velocity;
+		sleep_time[i] = still ? sleep_time[i] + deltaTime : 0;
+
+		vel_x[i] += force_x[i] * inv_mass[i] * deltaTime;
+		vel_y[i] += force_y[i] * inv_mass[i] * deltaTime;
+		ang_vel[i] += torque[i] * inv_moi[i] * deltaTime;
+
+		if(std::fabs(vel_x[i]) < rest_velocity)
+			vel_x[i] = 0;
+		if(std::fabs(vel_y[i]) < rest_velocity)
+			vel_y[i] = 0;
+		if(std::fabs(ang_vel[i]) < rest_angular_velocity)
+			ang_vel[i] = 0;
+
+		step_x[i] = vel_x[i] * deltaTime;
+		step_y[i] = vel_y[i] * deltaTime;
+		step_rot[i] = ang_vel[i] * deltaTime;
+		pos_x[i] += step_x[i];
+		pos_y[i] += step_y[i];
+		rot[i] += step_rot[i];
+		force_x[i] = force_y[i] = torque[i] = 0;
+	}
+}
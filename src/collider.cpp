@@ -1,15 +1,45 @@
 #include "collider.h"
 #include "rigidbody2d.h"
+#include "aabbTree.h"
+#include "contactSolver.h"
+#include "collisionEvents.h"
 
 std::vector<Collider*> Collider::colliders;
-std::vector<Rigidbody2d*> Rigidbody2d::bodies; // TODO: BIG TEMPORARY
+std::vector<ColliderPair> Collider::pairs;
+std::vector<StaticColliderSource*> Collider::static_sources;
+std::vector<Collider*> Collider::static_query;
+std::vector<std::pair<Rigidbody2d*, Rigidbody2d*>> Collider::body_contacts;
+AABBTree Collider::tree;
+std::unordered_map<uint64_t, GJKCache> Collider::gjk_cache;
+std::vector<GJKCache*> Collider::pair_caches;
+std::vector<Collider::NarrowphaseBuffer> Collider::buffers;
+std::vector<Collider::PairContact> Collider::contacts;
+WorkerPool Collider::workers;
+thread_local CollisionStats Collider::thread_stats;
+Collider::BROADPHASE_TYPE Collider::broadphase = Collider::AABB_TREE;
+CollisionStats Collider::stats;
+unsigned Collider::gjk_max_iterations = 32;
+unsigned Collider::gjk_cache_lifetime = 8;
+float Collider::epa_tolerance = 0.001f;
+unsigned Collider::epa_max_iterations = 32;
+unsigned Collider::toi_iterations = 16;
+unsigned Collider::narrowphase_batch_size = 32;
+unsigned Collider::step = 0;
+unsigned Collider::next_uid = 0;
+uint32_t Collider::layer_ignore[32] = {};
+std::vector<std::string> Collider::layer_names = {"default"};
 
-Collider::Collider(std::string id) : Object2d(id) {
-	colliders.push_back(this);
+Collider::Collider(std::string id, bool is_static) : Object2d(id), uid(next_uid++), is_static(is_static) {
+	if(!is_static)
+		colliders.push_back(this);
 }
 
 Collider::~Collider() {
-	colliders.erase(std::find(colliders.begin(), colliders.end(), this));
+	if(!is_static)
+		colliders.erase(std::find(colliders.begin(), colliders.end(), this));
+	if(proxy != -1)
+		tree.destroyProxy(proxy);
+	CollisionEvents::forget(this);
 }
 
 // Object2d& MeshCollider::setPos(glm::vec2 position) {
@@ -45,65 +75,642 @@ Collider::~Collider() {
 // 	return *this;
 // }
 
-Line& debug_rvec() {
-	static Line l(glm::vec2(0), glm::vec2(0), glm::vec3(1, 0, 0));
-	return l;
+// Walks up the hierarchy once to get this step's world transform, so support queries
+// don't have to. Shapes only rebuild their world space data if the transform changed
+void Collider::updateTransform() {
+	Affine2d transform = getWorldAffine();
+	if(transform_cached && transform == world_affine)
+		return;
+
+	world_affine = transform;
+	world_transform = transform.toMat4();
+	transform_cached = true;
+	transformChanged();
+	stats.transforms_changed++;
 }
 
-Path& debug_polytope() {
-	static Path p(glm::vec3(0, 1, 0));
-	return p;
+// Recalculates the world space bounding box using the support function along each axis
+void Collider::updateBounds() {
+	bounding_box.lower_left = glm::vec2(
+		furthestPoint(glm::vec2(-1, 0)).x,
+		furthestPoint(glm::vec2(0, -1)).y
+	);
+	bounding_box.upper_right = glm::vec2(
+		furthestPoint(glm::vec2(1, 0)).x,
+		furthestPoint(glm::vec2(0, 1)).y
+	);
 }
 
-Path& debug_polytope2() {
-	static Path p(glm::vec3(0, .5, .5));
-	return p;
+glm::vec2 Collider::getWorldCenter() const {
+	return glm::vec2(world_transform * glm::vec4(center, 0, 1));
 }
 
-void Collider::checkAll(float deltaTime) {
-	for(auto it = colliders.begin(); it != colliders.end(); it++) { // For every collider
-		Collider& c1 = **it;
-
-		for(auto jt = std::next(it); jt != colliders.end(); jt++) { // Compare with every other collider after this one
-			Collider& c2 = **jt;
-			c2.getWorldPos();
-			// if(c1.bounding_box.intersects(c2.bounding_box)) { // If their bounding boxes intersect
-				Simplex simplex;
-				bool colliding = checkCollision(c1, c2, &simplex);
-
-				debug_polytope2().setVertsLoop(simplex.copyToVec());
-
-				if(colliding) {
-					glm::vec2 resolve = resolutionVector(c1, c2, simplex.copyToVec());
-					debug_rvec().setPoints(c1.getWorldPos(), c1.getWorldPos() + resolve);
-					
-					Rigidbody2d *b1 = nullptr, *b2 = nullptr;
-
-					// Check to see if this collider belongs to a rigidbody. If it does, apply appropriate force to the object
-					try {
-						b1 = c1.parent->as<Rigidbody2d>();
-					} catch(ObjectCastException&) {}
-
-					try {
-						b2 = c2.parent->as<Rigidbody2d>();
-					} catch(ObjectCastException&) {}
-
-					if(b1 != nullptr && b2 != nullptr) {
-						b1->displace(-resolve / 2.f);
-						b2->displace(resolve / 2.f);
-						Rigidbody2d::collide(resolve, b1, b2, 0);
-					} else if(b1 != nullptr) {
-						b1->displace(-resolve);
-						b1->applyForce(b1->getMass() * -b1->velocity * c1.elasticity, resolve); // this is wrong, -velocity will send a diagonally approaching object back the way it came
-					} else if(b2 != nullptr) {
-						b2->displace(resolve);
-						b2->applyForce(b2->getMass() * -b2->velocity * c2.elasticity, resolve); // this is wrong, -velocity will send a diagonally approaching object back the way it came
-					}
+bool Collider::isSleeping() const {
+	return is_static || (body && !body->isAwake());
+}
+
+// Checks if a world space point is inside this collider, using GJK against the point
+bool Collider::containsPoint(glm::vec2 point) {
+	Simplex simplex;
+	return gjk([this, point](glm::vec2 direction) {
+		return furthestPoint(direction) - point;
+	}, &simplex);
+}
+
+// Moves every collider's leaf to match its new bounding box
+void Collider::updateProxy() {
+	glm::vec2 last_center = bounding_box.getCenter();
+	updateTransform();
+	updateBounds();
+
+	if(proxy == -1) {
+		proxy = tree.createProxy(bounding_box, this);
+	} else if(tree.moveProxy(proxy, bounding_box, bounding_box.getCenter() - last_center)) {
+		stats.proxies_moved++;
+	}
+}
+
+void Collider::updateTree() {
+	for(Collider* c : colliders) {
+		if(c->proxy != -1 && c->isSleeping())
+			continue; // Sleeping bodies don't move, their box is still good
+		c->updateProxy();
+	}
+
+	stats.tree_height = tree.getHeight();
+}
+
+// Insertion sort on the left edge of the bounding boxes. Objects barely move between
+// steps, so the list is nearly sorted already and this stays close to O(n)
+void Collider::sortColliders() {
+	for(size_t i = 1; i < colliders.size(); i++) {
+		Collider* c = colliders[i];
+		float key = c->bounding_box.lower_left.x;
+
+		size_t j = i;
+		while(j > 0 && colliders[j - 1]->bounding_box.lower_left.x > key) {
+			colliders[j] = colliders[j - 1];
+			j--;
+		}
+		colliders[j] = c;
+	}
+}
 
+// Sweeps along the x axis of the sorted colliders
+void Collider::findPairsSweep() {
+	sortColliders();
+
+	for(auto it = colliders.begin(); it != colliders.end(); it++) {
+		Collider* c1 = *it;
+
+		// Only the colliders that start before this one ends can overlap it on the x axis
+		for(auto jt = std::next(it); jt != colliders.end() && (*jt)->bounding_box.lower_left.x <= c1->bounding_box.upper_right.x; jt++) {
+			Collider* c2 = *jt;
+			if(c1->bounding_box.intersects(c2->bounding_box)) { // Overlapping on x, check y too
+				if(!canCollide(*c1, *c2)) {
+					stats.pairs_filtered++;
+					continue;
+				}
+				if(c1->uid < c2->uid)
+					pairs.emplace_back(c1, c2);
+				else
+					pairs.emplace_back(c2, c1);
+			}
+		}
+	}
+}
+
+// Queries the tree with each awake collider's box, so the cost follows the active bodies rather than all of them.
+// Pairs of awake colliders are reported by the one with the lower proxy id, pairs with a sleeping one by the awake one
+void Collider::findPairsTree() {
+	for(Collider* c1 : colliders) {
+		if(c1->isSleeping())
+			continue;
+
+		tree.query(c1->bounding_box, [c1](int other) {
+			Collider* c2 = tree.getCollider(other);
+			if(c2 != c1 && (other > c1->proxy || c2->isSleeping()) && c1->bounding_box.intersects(c2->bounding_box)) {
+				if(!canCollide(*c1, *c2)) {
+					stats.pairs_filtered++;
+					return true;
 				}
-			// }
+				if(c1->uid < c2->uid)
+					pairs.emplace_back(c1, c2);
+				else
+					pairs.emplace_back(c2, c1);
+			}
+			return true;
+		});
+	}
+}
+
+// Pairs each moving collider with the static colliders its box overlaps
+void Collider::findStaticPairs() {
+	for(Collider* c : colliders) {
+		if(c->isSleeping())
+			continue;
+
+		for(StaticColliderSource* source : static_sources) {
+			static_query.clear();
+			source->queryStatic(c->bounding_box, static_query);
+
+			for(Collider* s : static_query) {
+				if(!c->bounding_box.intersects(s->bounding_box))
+					continue;
+				if(!canCollide(*c, *s)) {
+					stats.pairs_filtered++;
+					continue;
+				}
+
+				if(c->uid < s->uid)
+					pairs.emplace_back(c, s);
+				else
+					pairs.emplace_back(s, c);
+			}
+		}
+	}
+}
+
+bool Collider::canCollide(const Collider& a, const Collider& b) {
+	if(!(a.category & b.mask) || !(b.category & a.mask))
+		return false;
+
+	// Any one of a's layers that isn't blocked from all of b's is enough
+	uint32_t layers = a.category;
+	while(layers) {
+		unsigned layer = __builtin_ctz(layers);
+		if(b.category & ~layer_ignore[layer])
+			return true;
+		layers &= layers - 1;
+	}
+	return false;
+}
+
+void Collider::setLayersCollide(unsigned layer_a, unsigned layer_b, bool collide) {
+	if(layer_a >= 32 || layer_b >= 32) {
+		log("Collision layer out of range: " + std::to_string(std::max(layer_a, layer_b)), ERR);
+		return;
+	}
+
+	if(collide) {
+		layer_ignore[layer_a] &= ~(1u << layer_b);
+		layer_ignore[layer_b] &= ~(1u << layer_a);
+	} else {
+		layer_ignore[layer_a] |= 1u << layer_b;
+		layer_ignore[layer_b] |= 1u << layer_a;
+	}
+}
+
+uint32_t Collider::layerBit(const std::string& name) {
+	auto it = std::find(layer_names.begin(), layer_names.end(), name);
+	if(it != layer_names.end())
+		return 1u << (it - layer_names.begin());
+
+	if(layer_names.size() == 32) {
+		log("Out of collision layers, can't add \"" + name + "\"", ERR);
+		return 0;
+	}
+	layer_names.push_back(name);
+	return 1u << (layer_names.size() - 1);
+}
+
+uint32_t Collider::parseLayers(const Json::Value& j) {
+	if(j.isString())
+		return layerBit(j.asString());
+	if(j.isIntegral())
+		return j.asUInt();
+
+	uint32_t bits = 0;
+	if(j.isArray()) {
+		for(const Json::Value& layer : j)
+			bits |= parseLayers(layer);
+	}
+	return bits;
+}
+
+void Collider::loadFilter(const Json::Value& j) {
+	if(j.isMember("category"))
+		category = parseLayers(j["category"]);
+	if(j.isMember("mask"))
+		mask = parseLayers(j["mask"]);
+}
+
+void Collider::loadLayerMatrix(const Json::Value& j) {
+	for(const Json::Value& pair : j) {
+		if(!pair.isArray() || pair.size() != 2) {
+			log("Layer matrix entries should be pairs of layer names", ERR);
+			continue;
+		}
+
+		uint32_t a = layerBit(pair[0].asString());
+		uint32_t b = layerBit(pair[1].asString());
+		if(a && b)
+			setLayersCollide(__builtin_ctz(a), __builtin_ctz(b), false);
+	}
+}
+
+void Collider::addStaticSource(StaticColliderSource* source) {
+	if(std::find(static_sources.begin(), static_sources.end(), source) == static_sources.end())
+		static_sources.push_back(source);
+}
+
+void Collider::removeStaticSource(StaticColliderSource* source) {
+	auto it = std::find(static_sources.begin(), static_sources.end(), source);
+	if(it != static_sources.end())
+		static_sources.erase(it);
+}
+
+// Keys are order independent, pairs always go in with the lower uid first
+uint64_t Collider::pairKey(const Collider& a, const Collider& b) {
+	uint64_t low = std::min(a.uid, b.uid);
+	uint64_t high = std::max(a.uid, b.uid);
+	return (low << 32) | high;
+}
+
+// Drops cached pairs that haven't been tested in a while, they've most likely separated for good
+void Collider::evictCache() {
+	for(auto it = gjk_cache.begin(); it != gjk_cache.end();) {
+		if(step - it->second.last_step > gjk_cache_lifetime)
+			it = gjk_cache.erase(it);
+		else
+			it++;
+	}
+}
+
+void Collider::setNarrowphaseThreads(unsigned count) {
+	workers.setThreadCount(count);
+}
+
+// Runs GJK and EPA for every pair across the worker pool. Workers only read the colliders,
+// write to their own pair's cache entry, and collect contacts in their own buffer
+void Collider::narrowphase() {
+	pair_caches.clear();
+	for(auto& pair : pairs) {
+		GJKCache& cache = gjk_cache[pairKey(*pair.first, *pair.second)];
+		cache.last_step = step;
+		pair_caches.push_back(&cache);
+	}
+
+	buffers.resize(workers.getWorkerCount());
+	for(auto& buffer : buffers) {
+		buffer.contacts.clear();
+		buffer.stats = CollisionStats();
+	}
+
+	workers.parallelFor(pairs.size(), narrowphase_batch_size, [](unsigned begin, unsigned end, unsigned worker) {
+		NarrowphaseBuffer& buffer = buffers[worker];
+		thread_stats = CollisionStats();
+
+		for(unsigned i = begin; i < end; i++) {
+			Collider& c1 = *pairs[i].first;
+			Collider& c2 = *pairs[i].second;
+
+			Simplex simplex;
+			if(!checkCollision(c1, c2, &simplex, pair_caches[i]))
+				continue;
+			thread_stats.pairs_colliding++;
+
+			PairContact contact;
+			contact.pair = i;
+			if(contactManifold(c1, c2, simplex, &contact.manifold)) // Otherwise they're only touching
+				buffer.contacts.push_back(contact);
+		}
+
+		buffer.stats.accumulate(thread_stats);
+	});
+
+	// Batches finish in any order, sort by pair to get the same result as a single thread
+	contacts.clear();
+	for(auto& buffer : buffers) {
+		contacts.insert(contacts.end(), buffer.contacts.begin(), buffer.contacts.end());
+		stats.accumulate(buffer.stats);
+	}
+	std::sort(contacts.begin(), contacts.end(), [](const PairContact& a, const PairContact& b) {
+		return a.pair < b.pair;
+	});
+}
+
+void Collider::checkAll(float deltaTime) {
+	stats = CollisionStats();
+	stats.colliders = colliders.size();
+	step++;
+
+	// Broadphase: update each box once, then find the pairs with overlapping boxes. Every transform is brought up to
+	// date in one pass first, so colliders only have to read theirs
+	Object2d::updateTransforms();
+	updateTree();
+
+	pairs.clear();
+	if(broadphase == SWEEP_AND_PRUNE)
+		findPairsSweep();
+	else
+		findPairsTree();
+	findStaticPairs();
+
+	// Nothing can have changed between two sleeping colliders
+	auto awake_end = std::remove_if(pairs.begin(), pairs.end(), [](const ColliderPair& pair) {
+		return pair.first->isSleeping() && pair.second->isSleeping();
+	});
+	stats.pairs_sleeping = pairs.end() - awake_end;
+	pairs.erase(awake_end, pairs.end());
+
+#ifdef DETERMINISTIC_PHYSICS
+	// The broadphase's order depends on the tree's shape and the order colliders were sorted in,
+	// uids only depend on the order colliders were created in. The solver runs in pair order
+	std::sort(pairs.begin(), pairs.end(), [](const ColliderPair& a, const ColliderPair& b) {
+		return pairKey(*a.first, *a.second) < pairKey(*b.first, *b.second);
+	});
+#endif
+	stats.pairs_tested = pairs.size();
+
+	narrowphase();
+
+	// Solve in pair order, so the result doesn't depend on which thread found what
+	for(auto& contact : contacts) {
+		Collider& c1 = *pairs[contact.pair].first;
+		Collider& c2 = *pairs[contact.pair].second;
+		uint64_t key = pairKey(c1, c2);
+		ContactSolver::addContact(c1, c2, key, contact.manifold);
+		CollisionEvents::record(c1, c2, key, contact.manifold);
+	}
+	ContactSolver::solve(deltaTime);
+	CollisionEvents::finish();
+
+	// Bodies in contact sleep and wake together
+	body_contacts.clear();
+	for(auto& contact : contacts) {
+		Rigidbody2d* b1 = pairs[contact.pair].first->body;
+		Rigidbody2d* b2 = pairs[contact.pair].second->body;
+		if(b1 && b2)
+			body_contacts.emplace_back(b1, b2);
+	}
+	Rigidbody2d::updateIslands(body_contacts);
+
+	evictCache();
+}
+
+std::vector<Collider*> Collider::queryRegion(const BoundingBox& region) {
+	std::vector<Collider*> result;
+	tree.query(region, [&result, &region](int proxy) {
+		Collider* c = tree.getCollider(proxy);
+		if(c->bounding_box.intersects(region))
+			result.push_back(c);
+		return true;
+	});
+
+	return result;
+}
+
+std::vector<Collider*> Collider::queryPoint(glm::vec2 point) {
+	std::vector<Collider*> result;
+	tree.query(BoundingBox(point, point), [&result, point](int proxy) {
+		Collider* c = tree.getCollider(proxy);
+		if(c->bounding_box.containsPoint(point) && c->containsPoint(point))
+			result.push_back(c);
+		return true;
+	});
+
+	return result;
+}
+
+bool Collider::raycast(glm::vec2 origin, glm::vec2 direction, float max_distance, RaycastHit* hit, uint32_t mask) {
+	if(direction == glm::vec2(0))
+		return false;
+	direction = glm::normalize(direction);
+
+	RaycastHit closest;
+	closest.distance = max_distance;
+	bool found = false;
+
+	tree.raycast(origin, direction, max_distance, [&](int proxy, float max_fraction) {
+		Collider* c = tree.getCollider(proxy);
+		RaycastHit shape_hit;
+		if(!(c->category & mask) || !c->raycastShape(origin, direction, max_distance * max_fraction, &shape_hit))
+			return -1.f; // Missed the shape itself, keep going
+
+		closest = shape_hit;
+		found = true;
+		return shape_hit.distance / max_distance; // Only look for closer hits from here on
+	});
+
+	// Anything static has to be closer than the closest dynamic hit
+	for(StaticColliderSource* source : static_sources) {
+		source->raycastStatic(origin, direction, closest.distance, [&](const RaycastHit& static_hit) {
+			if(!(static_hit.collider->category & mask) || static_hit.distance >= closest.distance)
+				return closest.distance;
+
+			closest = static_hit;
+			found = true;
+			return static_hit.distance;
+		});
+	}
+
+	if(found && hit) {
+		*hit = closest;
+		hit->fraction = max_distance > 0 ? closest.distance / max_distance : 0;
+	}
+	return found;
+}
+
+unsigned Collider::raycastAll(glm::vec2 origin, glm::vec2 direction, float max_distance, std::vector<RaycastHit>& hits, uint32_t mask) {
+	hits.clear();
+	if(direction == glm::vec2(0))
+		return 0;
+	direction = glm::normalize(direction);
+
+	tree.raycast(origin, direction, max_distance, [&](int proxy, float /*max_fraction*/) {
+		Collider* c = tree.getCollider(proxy);
+		RaycastHit shape_hit;
+		if((c->category & mask) && c->raycastShape(origin, direction, max_distance, &shape_hit))
+			hits.push_back(shape_hit);
+		return -1.f; // Never clip, every hit is wanted
+	});
+
+	for(StaticColliderSource* source : static_sources) {
+		source->raycastStatic(origin, direction, max_distance, [&](const RaycastHit& static_hit) {
+			if(static_hit.collider->category & mask)
+				hits.push_back(static_hit);
+			return max_distance;
+		});
+	}
+
+	for(auto& h : hits)
+		h.fraction = max_distance > 0 ? h.distance / max_distance : 0;
+	std::sort(hits.begin(), hits.end(), [](const RaycastHit& a, const RaycastHit& b) {
+		return a.distance < b.distance || (a.distance == b.distance && a.collider->uid < b.collider->uid); // std::sort isn't stable, ties need an order of their own
+	});
+	return hits.size();
+}
+
+void StaticColliderSource::raycastStatic(glm::vec2 origin, glm::vec2 direction, float max_distance, const std::function<float(const RaycastHit&)>& callback) {
+	glm::vec2 end = origin + direction * max_distance;
+	std::vector<Collider*> candidates;
+	queryStatic(BoundingBox(glm::min(origin, end), glm::max(origin, end)), candidates);
+
+	for(Collider* c : candidates) {
+		RaycastHit hit;
+		if(c->raycastShape(origin, direction, max_distance, &hit))
+			max_distance = std::min(max_distance, callback(hit));
+	}
+}
+
+void Collider::gatherCandidates(const BoundingBox& region, std::vector<Collider*>& result) {
+	result = queryRegion(region);
+	for(StaticColliderSource* source : static_sources)
+		source->queryStatic(region, result);
+}
+
+// Finds where shape, moved by offset, first touches target along translation
+bool Collider::castShape(Collider& shape, glm::vec2 offset, glm::vec2 translation, Collider& target, RaycastHit* hit) {
+	float toi;
+	if(!timeOfImpact(shape, translation, target, &toi, offset))
+		return false;
+
+	// Step just past the time of impact so they overlap a little, then EPA gives the normal
+	float length = glm::length(translation);
+	glm::vec2 moved = offset + translation * std::min(toi + epa_tolerance * 2 / length, 1.f);
+	auto support = [&shape, &target, moved](glm::vec2 direction) {
+		return shape.furthestPoint(direction) + moved - target.furthestPoint(-direction);
+	};
+
+	glm::vec2 normal = -translation / length; // If EPA can't tell, face back along the cast
+	Simplex simplex;
+	float depth;
+	if(gjk(support, &simplex) && epa(support, simplex, &normal, &depth))
+		normal = -normal;
+
+	// The middle of where the two features overlap, on the target's surface
+	glm::vec2 shape_feature[2], target_feature[2];
+	unsigned shape_count = shape.supportFeature(-normal, shape_feature);
+	unsigned target_count = target.supportFeature(normal, target_feature);
+
+	glm::vec2 point;
+	if(target_count == 1) {
+		point = target_feature[0];
+	} else if(shape_count == 1) {
+		point = shape_feature[0] + moved;
+	} else {
+		glm::vec2 tangent = glm::normalize(target_feature[1] - target_feature[0]);
+		float target_min = glm::dot(target_feature[0], tangent), target_max = glm::dot(target_feature[1], tangent);
+		float shape_a = glm::dot(shape_feature[0] + moved, tangent), shape_b = glm::dot(shape_feature[1] + moved, tangent);
+		float low = std::max(target_min, std::min(shape_a, shape_b));
+		float high = std::min(target_max, std::max(shape_a, shape_b));
+		point = target_feature[0] + tangent * ((low + high) / 2.f - target_min);
+	}
+
+	hit->collider = &target;
+	hit->point = point;
+	hit->normal = normal;
+	hit->fraction = toi;
+	hit->distance = toi * length;
+	return true;
+}
+
+bool Collider::shapecast(Collider& shape, glm::vec2 from, glm::vec2 to, RaycastHit* hit, uint32_t mask) {
+	std::vector<RaycastHit> hits;
+	if(shapecastAll(shape, from, to, hits, mask) == 0)
+		return false;
+
+	if(hit)
+		*hit = hits.front();
+	return true;
+}
+
+unsigned Collider::shapecastAll(Collider& shape, glm::vec2 from, glm::vec2 to, std::vector<RaycastHit>& hits, uint32_t mask) {
+	hits.clear();
+	glm::vec2 translation = to - from;
+	if(translation == glm::vec2(0))
+		return 0;
+
+	shape.updateTransform();
+	shape.updateBounds();
+	glm::vec2 offset = from - glm::vec2(shape.world_transform[3]);
+
+	BoundingBox start(shape.bounding_box.lower_left + offset, shape.bounding_box.upper_right + offset);
+	BoundingBox end(start.lower_left + translation, start.upper_right + translation);
+	BoundingBox swept = BoundingBox::merge(start, end);
+
+	std::vector<Collider*> candidates;
+	gatherCandidates(swept, candidates);
+
+	for(Collider* target : candidates) {
+		if(target == &shape || !(target->category & mask) || !swept.intersects(target->bounding_box))
+			continue;
+
+		RaycastHit target_hit;
+		if(castShape(shape, offset, translation, *target, &target_hit))
+			hits.push_back(target_hit);
+	}
+
+	std::sort(hits.begin(), hits.end(), [](const RaycastHit& a, const RaycastHit& b) {
+		return a.distance < b.distance || (a.distance == b.distance && a.collider->uid < b.collider->uid); // std::sort isn't stable, ties need an order of their own
+	});
+	return hits.size();
+}
+
+// Bisects the time of impact. The moving shape swept over part of its path is its support point plus the
+// furthest end of that part of the path, so GJK can tell if it hits anything anywhere in that time range
+bool Collider::timeOfImpact(Collider& moving, glm::vec2 translation, Collider& target, float* toi, glm::vec2 offset) {
+	auto sweptHit = [&moving, &target, translation, offset](float start, float end) {
+		Simplex simplex;
+		return gjk([&](glm::vec2 direction) {
+			glm::vec2 point = moving.furthestPoint(direction) + offset + translation * start;
+			if(glm::dot(direction, translation) > 0)
+				point += translation * (end - start);
+			return point - target.furthestPoint(-direction);
+		}, &simplex);
+	};
+
+	if(sweptHit(0, 0) || !sweptHit(0, 1))
+		return false; // Already overlapping, or never touching
+
+	// Keep the earliest half that still hits
+	float start = 0, end = 1;
+	for(unsigned i = 0; i < toi_iterations; i++) {
+		float middle = (start + end) / 2.f;
+		if(sweptHit(start, middle))
+			end = middle;
+		else
+			start = middle;
+	}
+
+	*toi = start; // The last time known to be clear
+	return true;
+}
+
+bool Collider::sweep(Collider& moving, glm::vec2 translation, float* toi, Collider** hit) {
+	if(translation == glm::vec2(0))
+		return false;
+
+	moving.updateTransform();
+	moving.updateBounds();
+
+	// Everything that could be touched along the way
+	BoundingBox start = moving.bounding_box;
+	BoundingBox end(start.lower_left + translation, start.upper_right + translation);
+	BoundingBox swept = BoundingBox::merge(start, end);
+
+	std::vector<Collider*> candidates;
+	gatherCandidates(swept, candidates);
+
+	bool found = false;
+	float earliest = 1;
+	for(Collider* target : candidates) {
+		if(target == &moving || !canCollide(moving, *target) || !swept.intersects(target->bounding_box))
+			continue;
+
+		float target_toi;
+		if(timeOfImpact(moving, translation, *target, &target_toi) && target_toi < earliest) {
+			earliest = target_toi;
+			found = true;
+			if(hit)
+				*hit = target;
 		}
 	}
+
+	if(found)
+		*toi = earliest;
+	return found;
 }
 
 
@@ -120,33 +727,98 @@ const glm::vec2 Collider::normalCCW(glm::vec2 vec) {
 	return glm::vec2(-vec.y, vec.x);
 }
 
-// GJK
-bool Collider::checkCollision(Collider& colliderA, Collider& colliderB, Simplex* resultSimplex) {
-	// Get initial support point in any direction
-	glm::vec2 support = getSupport(colliderA, colliderB, glm::vec2(1, 0));
+// GJK, support(direction) returns the furthest point of the shape being tested against the origin
+// If a cache is given, the test starts from where it ended last time and the cache is updated with the result
+template<typename Support>
+bool Collider::gjk(Support support, Simplex* resultSimplex, GJKCache* cache) {
+	glm::vec2 direction = glm::vec2(1, 0);
+
+	if(cache) {
+		// Rebuild last step's simplex from this step's support points, if it still encloses the origin we're done
+		if(cache->colliding && cache->simplex.size() == 3) {
+			Simplex warm;
+			for(unsigned i = 3; i-- > 0;) {
+				glm::vec2 d = cache->simplex.direction(i);
+				warm.push_front(support(d), d);
+			}
+
+			if(triangleContainsOrigin(warm)) {
+				thread_stats.gjk_warm_exits++;
+				cache->simplex = warm;
+				*resultSimplex = warm;
+				return true;
+			}
+		}
+
+		if(cache->direction != glm::vec2(0))
+			direction = cache->direction; // Otherwise start from the last search direction
+	}
+
+	// Get initial support point
+	glm::vec2 point = support(direction);
 
 	// Simplex is an array of points, max count is 4
 	Simplex simplex;
-	simplex.push_front(support);
+	simplex.push_front(point, direction);
 
-	// New direction is towards the origin
-	glm::vec2 direction = -support;
+	bool colliding = false;
+	unsigned iterations = 0;
 
-	while (true) {
-		support = getSupport(colliderA, colliderB, direction);
- 
-		if (glm::dot(support, direction) <= 0) {
-			*resultSimplex = simplex; 
-			return false; // no collision
-		}
+	if(glm::dot(point, direction) < 0) {
+		// Nothing is further along this direction than the origin, it's a separating axis.
+		// With a cached direction this is the usual case for pairs that are near but not touching
+		if(cache)
+			thread_stats.gjk_warm_exits++;
+	} else {
+		// New direction is towards the origin
+		direction = -point;
 
-		simplex.push_front(support);
+		while(iterations < gjk_max_iterations) {
+			iterations++;
+			point = support(direction);
 
-		if (nextSimplex(simplex, direction)) {
-			*resultSimplex = simplex;
-			return true;
+			if(glm::dot(point, direction) <= 0)
+				break; // no collision
+
+			simplex.push_front(point, direction);
+
+			if(nextSimplex(simplex, direction)) {
+				colliding = true;
+				break;
+			}
 		}
 	}
+
+	thread_stats.gjk_iterations += iterations;
+	if(cache) {
+		cache->direction = direction;
+		cache->simplex = simplex;
+		cache->colliding = colliding;
+	}
+
+	*resultSimplex = simplex;
+	return colliding;
+}
+
+bool Collider::checkCollision(Collider& colliderA, Collider& colliderB, Simplex* resultSimplex, GJKCache* cache) {
+	return gjk([&colliderA, &colliderB](glm::vec2 direction) {
+		return getSupport(colliderA, colliderB, direction);
+	}, resultSimplex, cache);
+}
+
+// Full check for a triangle that didn't come from the usual GJK steps, so any region could hold the origin
+bool Collider::triangleContainsOrigin(Simplex& points) {
+	glm::vec2 a = points[0], b = points[1], c = points[2];
+
+	auto side = [](glm::vec2 from, glm::vec2 to) {
+		return (to.x - from.x) * (-from.y) - (to.y - from.y) * (-from.x); // Cross product of the edge and the origin
+	};
+
+	float ab = side(a, b), bc = side(b, c), ca = side(c, a);
+	if(ab == 0 && bc == 0 && ca == 0)
+		return false; // Degenerate triangle
+
+	return (ab >= 0 && bc >= 0 && ca >= 0) || (ab <= 0 && bc <= 0 && ca <= 0);
 }
 
 bool Collider::nextSimplex(Simplex& points, glm::vec2& direction) {
@@ -173,8 +845,10 @@ bool Collider::lineCheck(Simplex& points, glm::vec2& direction) {
  
 	if (sameDirection(ab, ao)) {
 		direction = glm::cross(glm::cross(ab, ao), ab); // In 3d this would need to be glm::cross(glm::cross(ab, ao), ab);
+		if (direction == glm::vec2(0)) // The origin is on the line itself, search to one side of it
+			direction = normalCW(ab);
 	} else {
-		points = { a };
+		points.keep({0});
 		direction = ao;
 	}
 
@@ -194,14 +868,17 @@ bool Collider::triangleCheck(Simplex& points, glm::vec2& direction) {
  
 	if (sameDirection(glm::cross(abc, ac), ao)) { // In 3d, the first term is glm::cross(abc, ac)
 		if (sameDirection(ac, ao)) {
-			points = { a, c };
+			points.keep({0, 2});
 			direction = glm::cross(glm::cross(ac, ao), ac); // In 3d, this would be glm::cross(glm::cross(ac, ao), ac);
+			if (direction == glm::vec2(0))
+				direction = normalCCW(ac);
+			return false; // The origin is outside of edge ac, keep searching from there
 		} else {
-			return lineCheck(points = { a, b }, direction);
+			return lineCheck(points.keep({0, 1}), direction);
 		}
 	} else {
 		if (sameDirection(glm::cross(ab, abc), ao)) { // In 3d, the first term here is glm::cross(ab, abc)
-			return lineCheck(points = { a, b }, direction);
+			return lineCheck(points.keep({0, 1}), direction);
 		}
 
 		// In 3d, this checks if the point is above or below the triangle
@@ -221,55 +898,362 @@ bool Collider::triangleCheck(Simplex& points, glm::vec2& direction) {
 }
 
 // EPA
-glm::vec2 Collider::resolutionVector(Collider& colliderA, Collider& colliderB, std::vector<glm::vec2> polytope) {
-	auto minIndex = polytope.begin();
-	float minDistance = std::numeric_limits<float>::max();
-	glm::vec2 minNormal;
-	while (minDistance == std::numeric_limits<float>::max()) {
-		for (auto it = polytope.begin(); it != polytope.end(); it++) {
-			auto jt = std::next(it); // Iterator to next element
-			if(jt == polytope.end()) // Loop around if we reach the end
-				jt = polytope.begin();
-
-			glm::vec2 vertexI = *it;
-			glm::vec2 vertexJ = *jt;
-
-			glm::vec2 vecIJ = vertexJ - vertexI;
-
-			glm::vec2 normal = glm::normalize(normalCW(vecIJ));
-			float distance = glm::dot(normal, vertexI);
-
-			if (distance < 0) {
-				distance *= -1;
-				normal *= -1;
-			}
+namespace {
+	struct EPAEdge {
+		glm::vec2 a, b; // Counter clockwise around the polytope
+		glm::vec2 normal; // Outward facing, unit length
+		float distance; // From the origin to the edge's line
+	};
 
-			if (distance < minDistance) {
-				minDistance = distance;
-				minNormal = normal;
-				minIndex = jt;
-			}
-		}
+	// Closest edge on top
+	bool furtherEdge(const EPAEdge& e1, const EPAEdge& e2) {
+		return e1.distance > e2.distance;
+	}
+}
+
+bool Collider::contactManifold(Collider& colliderA, Collider& colliderB, Simplex& simplex, ContactManifold* manifold) {
+	auto support = [&colliderA, &colliderB](glm::vec2 direction) {
+		return getSupport(colliderA, colliderB, direction);
+	};
+	if(!epa(support, simplex, &manifold->normal, &manifold->depth))
+		return false;
+
+	findContactPoints(colliderA, colliderB, manifold);
+	return true;
+}
+
+template<typename Support>
+bool Collider::epa(Support support, Simplex& simplex, glm::vec2* normal, float* depth) {
+	if(simplex.size() < 3)
+		return false;
+
+	// Every expansion pops one edge and pushes two, so the polytope lives in a fixed size heap on the stack
+	EPAEdge heap[epa_capacity];
+	unsigned count = 0;
+
+	auto pushEdge = [&heap, &count](glm::vec2 a, glm::vec2 b) {
+		glm::vec2 edge = b - a;
+		if(edge == glm::vec2(0))
+			return; // Duplicate point, the edge adds nothing
+
+		EPAEdge& e = heap[count++];
+		e.a = a;
+		e.b = b;
+		e.normal = glm::normalize(normalCW(edge));
+		e.distance = glm::dot(e.normal, a);
+		std::push_heap(heap, heap + count, furtherEdge);
+	};
+
+	glm::vec2 a = simplex[0], b = simplex[1], c = simplex[2];
+	float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if(area == 0)
+		return false; // Degenerate simplex, the origin is on its boundary so they're only touching
+	if(area < 0)
+		std::swap(b, c);
+
+	pushEdge(a, b);
+	pushEdge(b, c);
+	pushEdge(c, a);
+
+	EPAEdge closest;
+	unsigned iterations = 0;
+	while(true) {
+		std::pop_heap(heap, heap + count, furtherEdge);
+		closest = heap[--count];
+
+		if(iterations >= epa_max_iterations || count + 2 > epa_capacity)
+			break; // Out of budget, the closest edge so far is a good enough answer
+		iterations++;
+
+		glm::vec2 point = support(closest.normal);
+		if(glm::dot(point, closest.normal) - closest.distance < epa_tolerance)
+			break; // This edge is on the boundary of the Minkowski difference
+
+		pushEdge(closest.a, point);
+		pushEdge(point, closest.b);
+	}
+	thread_stats.epa_iterations += iterations;
+
+	if(closest.distance <= 0)
+		return false;
+
+	*normal = closest.normal;
+	*depth = closest.distance;
+	return true;
+}
+
+// Clips the incident feature against the sides of the reference feature, the one most perpendicular to the normal.
+// Whatever is left past the reference face is in contact
+void Collider::findContactPoints(Collider& colliderA, Collider& colliderB, ContactManifold* manifold) {
+	glm::vec2 feature_a[2], feature_b[2];
+	unsigned count_a = colliderA.supportFeature(manifold->normal, feature_a);
+	unsigned count_b = colliderB.supportFeature(-manifold->normal, feature_b);
+
+	// A vertex or a circle can only touch at one point
+	if(count_a == 1 || count_b == 1) {
+		manifold->points[0] = (count_a == 1) ? feature_a[0] : feature_b[0];
+		manifold->point_count = 1;
+		return;
+	}
+
+	glm::vec2* reference = feature_a;
+	glm::vec2* incident = feature_b;
+	glm::vec2 reference_normal = manifold->normal;
+	if(std::abs(glm::dot(glm::normalize(feature_b[1] - feature_b[0]), manifold->normal)) <
+	   std::abs(glm::dot(glm::normalize(feature_a[1] - feature_a[0]), manifold->normal))) {
+		std::swap(reference, incident);
+		reference_normal = -reference_normal;
+	}
+
+	glm::vec2 clipped[2] = { incident[0], incident[1] };
+
+	// Keeps the part of the clipped segment where dot(direction, point) >= offset
+	auto clip = [&clipped](glm::vec2 direction, float offset) {
+		float d0 = glm::dot(direction, clipped[0]) - offset;
+		float d1 = glm::dot(direction, clipped[1]) - offset;
+		if(d0 < 0 && d1 < 0)
+			return false;
 
-		glm::vec2 support = getSupport(colliderA, colliderB, minNormal);
-		float sDistance = glm::dot(minNormal, support);
+		if(d0 < 0)
+			clipped[0] += (clipped[1] - clipped[0]) * (d0 / (d0 - d1));
+		else if(d1 < 0)
+			clipped[1] += (clipped[0] - clipped[1]) * (d1 / (d1 - d0));
+		return true;
+	};
 
-		if(abs(sDistance - minDistance) > 0.001) {
-		 	minDistance = std::numeric_limits<float>::max();
-			polytope.insert(minIndex, support);
+	glm::vec2 tangent = glm::normalize(reference[1] - reference[0]);
+	glm::vec2 face_normal = normalCW(tangent);
+	if(glm::dot(face_normal, reference_normal) < 0)
+		face_normal = -face_normal;
+	float face = glm::dot(face_normal, reference[0]);
+
+	manifold->point_count = 0;
+	if(clip(tangent, glm::dot(tangent, reference[0])) && clip(-tangent, -glm::dot(tangent, reference[1]))) {
+		for(glm::vec2 point : clipped) {
+			if(glm::dot(face_normal, point) <= face + epa_tolerance)
+				manifold->points[manifold->point_count++] = point;
 		}
 	}
 
-	debug_polytope().setVertsLoop(polytope);
-	return minNormal * (minDistance + 0.001f);
+	// Nothing survived clipping, fall back to the deepest incident vertex
+	if(manifold->point_count == 0) {
+		bool first = glm::dot(face_normal, incident[0]) < glm::dot(face_normal, incident[1]);
+		manifold->points[0] = first ? incident[0] : incident[1];
+		manifold->point_count = 1;
+	}
 }
 
 
 // MeshCollider ////////////////////////////////////////////////////////
 
-MeshCollider::MeshCollider(std::string id, std::vector<glm::vec2> points) :
-	Collider(id),
-	vertices(points)	
+MeshCollider::MeshCollider(std::string id, std::vector<glm::vec2> points, bool is_static) :
+	Collider(id, is_static),
+	vertices(points),
+	hull(convexHull(points))
 {
-	bounding_box.setBounds(points);
-}
\ No newline at end of file
+	world_hull = hull;
+}
+
+void MeshCollider::transformChanged() {
+	for(size_t i = 0; i < hull.size(); i++)
+		world_hull[i] = world_transform * glm::vec4(hull[i], 0, 1);
+}
+
+unsigned MeshCollider::supportIndex(glm::vec2 direction) {
+	if(!transform_cached)
+		updateTransform();
+
+	unsigned count = world_hull.size();
+	if(count <= hill_climb_threshold) {
+		unsigned max_index = 0;
+		float max_dist = -std::numeric_limits<float>::max();
+
+		for(unsigned i = 0; i < count; i++) {
+			float distance = glm::dot(world_hull[i], direction);
+			if(distance > max_dist) {
+				max_dist = distance;
+				max_index = i;
+			}
+		}
+
+		return max_index;
+	}
+
+	// The hull is convex, so moving towards whichever neighbor is further along the direction
+	// always leads to the support point. Successive queries tend to be in similar directions,
+	// so starting from the last result usually only takes a step or two
+	unsigned current = last_support.load(std::memory_order_relaxed);
+	if(current >= count)
+		current = 0;
+	float current_dist = glm::dot(world_hull[current], direction);
+
+	while(true) {
+		unsigned next = (current + 1) % count;
+		unsigned prev = (current + count - 1) % count;
+		float next_dist = glm::dot(world_hull[next], direction);
+		float prev_dist = glm::dot(world_hull[prev], direction);
+
+		if(next_dist > current_dist && next_dist >= prev_dist) {
+			current = next;
+			current_dist = next_dist;
+		} else if(prev_dist > current_dist) {
+			current = prev;
+			current_dist = prev_dist;
+		} else {
+			break;
+		}
+	}
+
+	last_support.store(current, std::memory_order_relaxed);
+
+	// An edge facing exactly along direction has two support points. Take the lower index like the linear
+	// search does, so the answer doesn't depend on where the climb started, which depends on thread timing
+	unsigned next = (current + 1) % count;
+	unsigned prev = (current + count - 1) % count;
+	if(prev < current && glm::dot(world_hull[prev], direction) == current_dist)
+		current = prev;
+	else if(next < current && glm::dot(world_hull[next], direction) == current_dist)
+		current = next;
+	return current;
+}
+
+glm::vec2 MeshCollider::furthestPoint(glm::vec2 direction) {
+	return world_hull[supportIndex(direction)];
+}
+
+unsigned MeshCollider::supportFeature(glm::vec2 direction, glm::vec2 feature[2]) {
+	unsigned current = supportIndex(direction);
+	unsigned count = world_hull.size();
+
+	feature[0] = world_hull[current];
+	if(count < 2)
+		return 1;
+
+	// Of the two edges on the support vertex, the one facing the direction is the most perpendicular to it
+	glm::vec2 prev = world_hull[(current + count - 1) % count];
+	glm::vec2 next = world_hull[(current + 1) % count];
+	direction = glm::normalize(direction);
+
+	if(std::abs(glm::dot(glm::normalize(feature[0] - prev), direction)) <= std::abs(glm::dot(glm::normalize(next - feature[0]), direction))) {
+		feature[1] = feature[0];
+		feature[0] = prev;
+	} else {
+		feature[1] = next;
+	}
+	return 2;
+}
+
+
+// Andrew's monotone chain, returns the hull in counter clockwise order without collinear points
+std::vector<glm::vec2> MeshCollider::convexHull(std::vector<glm::vec2> points) {
+	if(points.size() < 3)
+		return points;
+
+	std::sort(points.begin(), points.end(), [](const glm::vec2& a, const glm::vec2& b) {
+		return a.x < b.x || (a.x == b.x && a.y < b.y);
+	});
+
+	auto cross = [](glm::vec2 o, glm::vec2 a, glm::vec2 b) {
+		return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+	};
+
+	std::vector<glm::vec2> result(points.size() * 2);
+	size_t k = 0;
+
+	// Lower hull
+	for(size_t i = 0; i < points.size(); i++) {
+		while(k >= 2 && cross(result[k - 2], result[k - 1], points[i]) <= 0)
+			k--;
+		result[k++] = points[i];
+	}
+
+	// Upper hull
+	for(size_t i = points.size() - 1, lower = k + 1; i > 0; i--) {
+		while(k >= lower && cross(result[k - 2], result[k - 1], points[i - 1]) <= 0)
+			k--;
+		result[k++] = points[i - 1];
+	}
+
+	result.resize(k - 1); // The last point is the same as the first
+	return result;
+}
+
+bool MeshCollider::raycastShape(glm::vec2 origin, glm::vec2 direction, float max_distance, RaycastHit* hit) {
+	if(!transform_cached)
+		updateTransform();
+
+	// Winding decides which side of each edge is outside, a mirrored transform flips it
+	float area = 0;
+	for(size_t i = 0; i < world_hull.size(); i++) {
+		glm::vec2 a = world_hull[i];
+		glm::vec2 b = world_hull[(i + 1) % world_hull.size()];
+		area += a.x * b.y - a.y * b.x;
+	}
+
+	// Clip the ray against each edge's half plane (Cyrus-Beck)
+	float enter = 0, exit = max_distance;
+	glm::vec2 enter_normal(0);
+	for(size_t i = 0; i < world_hull.size(); i++) {
+		glm::vec2 a = world_hull[i];
+		glm::vec2 b = world_hull[(i + 1) % world_hull.size()];
+		glm::vec2 normal = (area > 0) ? normalCW(b - a) : normalCCW(b - a); // Outward facing
+
+		float numerator = glm::dot(normal, a - origin);
+		float denominator = glm::dot(normal, direction);
+
+		if(denominator == 0) {
+			if(numerator < 0)
+				return false; // Parallel to this edge and outside of it
+			continue;
+		}
+
+		float t = numerator / denominator;
+		if(denominator < 0) { // Entering this half plane
+			if(t > enter) {
+				enter = t;
+				enter_normal = normal;
+			}
+		} else { // Leaving it
+			exit = std::min(exit, t);
+		}
+
+		if(enter > exit)
+			return false;
+	}
+
+	if(enter_normal == glm::vec2(0))
+		return false; // The ray started inside the shape
+
+	hit->collider = this;
+	hit->distance = enter;
+	hit->point = origin + direction * enter;
+	hit->normal = glm::normalize(enter_normal);
+	return true;
+}
+
+// CircleCollider //////////////////////////////////////////////////////
+
+bool CircleCollider::raycastShape(glm::vec2 origin, glm::vec2 direction, float max_distance, RaycastHit* hit) {
+	if(!transform_cached)
+		updateTransform();
+
+	glm::vec2 offset = origin - world_center;
+	float b = glm::dot(offset, direction);
+	float c = glm::dot(offset, offset) - radius * radius;
+	if(c < 0)
+		return false; // The ray started inside the circle
+
+	float discriminant = b * b - c;
+	if(discriminant < 0 || b > 0)
+		return false;
+
+	float distance = -b - sqrt(discriminant);
+	if(distance > max_distance)
+		return false;
+
+	hit->collider = this;
+	hit->distance = distance;
+	hit->point = origin + direction * distance;
+	hit->normal = glm::normalize(hit->point - world_center);
+	return true;
+}
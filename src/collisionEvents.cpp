@@ -0,0 +1,75 @@
+#include "collisionEvents.h"
+
+#include <algorithm>
+
+std::vector<CollisionEvents::Touch> CollisionEvents::touching;
+std::vector<CollisionEvents::Touch> CollisionEvents::recorded;
+std::vector<CollisionEvent> CollisionEvents::events;
+
+const std::vector<CollisionEvent>& CollisionEvents::get() {
+	return events;
+}
+
+void CollisionEvents::record(Collider& a, Collider& b, uint64_t key, const ContactManifold& manifold) {
+	recorded.push_back({key, &a, &b, manifold});
+}
+
+void CollisionEvents::finish() {
+	auto byKey = [](const Touch& t1, const Touch& t2) { return t1.key < t2.key; };
+	std::stable_sort(recorded.begin(), recorded.end(), byKey);
+	recorded.erase(std::unique(recorded.begin(), recorded.end(), [](const Touch& t1, const Touch& t2) {
+		return t1.key == t2.key;
+	}), recorded.end());
+
+	// A pair from last step that wasn't recorded this step
+	auto untouched = [](const Touch& old) {
+		// Sleeping pairs aren't tested, but they can't have moved apart either
+		if(old.a && old.b && old.a->isSleeping() && old.b->isSleeping()) {
+			recorded.push_back(old);
+			events.push_back({CollisionEvent::STAY, old.key, old.a, old.b, old.manifold});
+		} else {
+			events.push_back({CollisionEvent::END, old.key, old.a, old.b, old.manifold});
+		}
+	};
+
+	// Both lists are sorted, so one walk down them pairs up this step's contacts with last step's
+	events.clear();
+	unsigned recorded_count = recorded.size();
+	auto old = touching.begin();
+	for(unsigned i = 0; i < recorded_count; i++) {
+		Touch touch = recorded[i]; // Copied, untouched() can grow recorded
+		for(; old != touching.end() && old->key < touch.key; old++)
+			untouched(*old);
+
+		bool was_touching = old != touching.end() && old->key == touch.key;
+		if(was_touching)
+			old++;
+		events.push_back({was_touching ? CollisionEvent::STAY : CollisionEvent::BEGIN, touch.key, touch.a, touch.b, touch.manifold});
+	}
+	for(; old != touching.end(); old++)
+		untouched(*old);
+
+	// Sleeping pairs were carried over onto the end
+	std::inplace_merge(recorded.begin(), recorded.begin() + recorded_count, recorded.end(), byKey);
+	touching.swap(recorded);
+	recorded.clear();
+}
+
+void CollisionEvents::forget(const Collider* collider) {
+	auto clear = [collider](Collider*& pointer) {
+		if(pointer == collider)
+			pointer = nullptr;
+	};
+
+	for(Touch& touch : touching) {
+		clear(touch.a);
+		clear(touch.b);
+	}
+	for(CollisionEvent& event : events) {
+		clear(event.a);
+		clear(event.b);
+	}
+	recorded.erase(std::remove_if(recorded.begin(), recorded.end(), [collider](const Touch& touch) {
+		return touch.a == collider || touch.b == collider;
+	}), recorded.end());
+}
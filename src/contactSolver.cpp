@@ -0,0 +1,243 @@
+#include "contactSolver.h"
+#include "rigidbody2d.h"
+
+unsigned ContactSolver::velocity_iterations = 8;
+unsigned ContactSolver::position_iterations = 4;
+float ContactSolver::baumgarte = 0.2f;
+float ContactSolver::penetration_slop = 0.005f;
+float ContactSolver::restitution_threshold = 0.5f;
+float ContactSolver::warm_start_distance = 0.05f;
+bool ContactSolver::warm_starting = true;
+
+std::vector<ContactSolver::Contact> ContactSolver::contacts;
+std::vector<ContactSolver::SolverBody> ContactSolver::solver_bodies;
+std::vector<int> ContactSolver::body_slots;
+std::vector<ContactSolver::SolverContact> ContactSolver::solver_contacts;
+std::unordered_map<uint64_t, ContactSolver::CachedImpulses> ContactSolver::impulse_cache;
+unsigned ContactSolver::step = 0;
+
+// 2D cross products
+static float cross(glm::vec2 a, glm::vec2 b) {
+	return a.x * b.y - a.y * b.x;
+}
+
+static glm::vec2 cross(float w, glm::vec2 r) {
+	return glm::vec2(-w * r.y, w * r.x);
+}
+
+void ContactSolver::addContact(Collider& a, Collider& b, uint64_t key, const ContactManifold& manifold) {
+	contacts.push_back({&a, &b, key, manifold});
+}
+
+void ContactSolver::solve(float deltaTime) {
+	step++;
+
+	const BodyStore& store = Rigidbody2d::getStore();
+	body_slots.assign(store.size(), -1);
+	solver_bodies.clear();
+	solver_bodies.emplace_back(); // Slot 0 never moves
+	solver_contacts.clear();
+
+	for(auto& contact : contacts)
+		prepare(contact, deltaTime);
+
+	if(warm_starting) {
+		for(auto& contact : solver_contacts)
+			warmStart(contact);
+	}
+
+	for(unsigned i = 0; i < velocity_iterations; i++) {
+		for(auto& contact : solver_contacts)
+			solveContact(contact);
+	}
+
+	for(unsigned i = 0; i < position_iterations; i++) {
+		for(auto& contact : solver_contacts)
+			solvePush(contact);
+	}
+
+	for(unsigned i = 1; i < solver_bodies.size(); i++) {
+		SolverBody& body = solver_bodies[i];
+		body.body->setVelocity(body.velocity);
+		body.body->setAngularVelocity(glm::degrees(body.angular_velocity));
+		if(body.push_velocity != glm::vec2(0))
+			body.body->displace(body.push_velocity * deltaTime);
+	}
+
+	storeImpulses();
+	contacts.clear();
+}
+
+// Finds or fills in the solver body for a collider
+unsigned ContactSolver::bodySlot(Collider& collider) {
+	Rigidbody2d* body = collider.body;
+	if(!body || collider.is_static)
+		return 0;
+
+	int& slot = body_slots[Rigidbody2d::getStore().index(body->getHandle())];
+	if(slot == -1) {
+		slot = solver_bodies.size();
+
+		SolverBody solver_body;
+		solver_body.velocity = body->getVelocity();
+		solver_body.angular_velocity = glm::radians(body->getAngularVelocity());
+		solver_body.inv_mass = body->getInverseMass();
+		solver_body.inv_inertia = body->getInverseInertia();
+		solver_body.body = body;
+		solver_bodies.push_back(solver_body);
+	}
+	return slot;
+}
+
+void ContactSolver::prepare(const Contact& contact, float deltaTime) {
+	SolverContact solver_contact;
+	solver_contact.body_a = bodySlot(*contact.a);
+	solver_contact.body_b = bodySlot(*contact.b);
+	if(solver_contact.body_a == 0 && solver_contact.body_b == 0)
+		return;
+
+	const ContactManifold& manifold = contact.manifold;
+	SolverBody& a = solver_bodies[solver_contact.body_a];
+	SolverBody& b = solver_bodies[solver_contact.body_b];
+	glm::vec2 center_a = contact.a->getWorldCenter();
+	glm::vec2 center_b = contact.b->getWorldCenter();
+	glm::vec2 normal = manifold.normal;
+	glm::vec2 tangent(normal.y, -normal.x);
+
+	solver_contact.key = contact.key;
+	solver_contact.normal = normal;
+	solver_contact.friction = std::sqrt(contact.a->friction * contact.b->friction);
+	solver_contact.point_count = manifold.point_count;
+	float restitution = std::max(contact.a->elasticity, contact.b->elasticity);
+
+	// Push out whatever is past the slop. The manifold has one depth for all of its points, so the bodies are
+	// moved straight along the normal rather than turned
+	solver_contact.push_mass = a.inv_mass + b.inv_mass > 0 ? 1 / (a.inv_mass + b.inv_mass) : 0;
+	solver_contact.push_impulse = 0;
+	solver_contact.push_bias = baumgarte / deltaTime * std::max(manifold.depth - penetration_slop, 0.f);
+
+	// Reuse last step's impulses for points that haven't moved much
+	auto cached = impulse_cache.find(contact.key);
+
+	for(unsigned i = 0; i < manifold.point_count; i++) {
+		SolverPoint& point = solver_contact.points[i];
+		point.position = manifold.points[i];
+		point.r_a = manifold.points[i] - center_a;
+		point.r_b = manifold.points[i] - center_b;
+
+		float rn_a = cross(point.r_a, normal);
+		float rn_b = cross(point.r_b, normal);
+		point.normal_mass = 1 / (a.inv_mass + b.inv_mass + a.inv_inertia * rn_a * rn_a + b.inv_inertia * rn_b * rn_b);
+
+		float rt_a = cross(point.r_a, tangent);
+		float rt_b = cross(point.r_b, tangent);
+		point.tangent_mass = 1 / (a.inv_mass + b.inv_mass + a.inv_inertia * rt_a * rt_a + b.inv_inertia * rt_b * rt_b);
+
+		// Bounce if they're closing fast enough
+		glm::vec2 relative = b.velocity + cross(b.angular_velocity, point.r_b) - a.velocity - cross(a.angular_velocity, point.r_a);
+		float closing = glm::dot(relative, normal);
+		point.bias = closing < -restitution_threshold ? -restitution * closing : 0;
+
+		point.normal_impulse = 0;
+		point.tangent_impulse = 0;
+		if(cached == impulse_cache.end())
+			continue;
+
+		const CachedImpulses& last = cached->second;
+		for(unsigned j = 0; j < last.point_count; j++) {
+			if(glm::distance(last.points[j], manifold.points[i]) < warm_start_distance) {
+				point.normal_impulse = last.normal_impulse[j];
+				point.tangent_impulse = last.tangent_impulse[j];
+				break;
+			}
+		}
+	}
+
+	solver_contacts.push_back(solver_contact);
+}
+
+void ContactSolver::applyImpulse(SolverContact& contact, const SolverPoint& point, glm::vec2 impulse) {
+	SolverBody& a = solver_bodies[contact.body_a];
+	SolverBody& b = solver_bodies[contact.body_b];
+
+	a.velocity -= impulse * a.inv_mass;
+	a.angular_velocity -= cross(point.r_a, impulse) * a.inv_inertia;
+	b.velocity += impulse * b.inv_mass;
+	b.angular_velocity += cross(point.r_b, impulse) * b.inv_inertia;
+}
+
+void ContactSolver::warmStart(SolverContact& contact) {
+	glm::vec2 tangent(contact.normal.y, -contact.normal.x);
+	for(unsigned i = 0; i < contact.point_count; i++) {
+		SolverPoint& point = contact.points[i];
+		applyImpulse(contact, point, contact.normal * point.normal_impulse + tangent * point.tangent_impulse);
+	}
+}
+
+void ContactSolver::solveContact(SolverContact& contact) {
+	SolverBody& a = solver_bodies[contact.body_a];
+	SolverBody& b = solver_bodies[contact.body_b];
+	glm::vec2 tangent(contact.normal.y, -contact.normal.x);
+
+	// Friction first, it's limited by the normal impulse from the last pass
+	for(unsigned i = 0; i < contact.point_count; i++) {
+		SolverPoint& point = contact.points[i];
+		glm::vec2 relative = b.velocity + cross(b.angular_velocity, point.r_b) - a.velocity - cross(a.angular_velocity, point.r_a);
+
+		float max_friction = contact.friction * point.normal_impulse;
+		float impulse = -glm::dot(relative, tangent) * point.tangent_mass;
+		float total = glm::clamp(point.tangent_impulse + impulse, -max_friction, max_friction);
+		impulse = total - point.tangent_impulse;
+		point.tangent_impulse = total;
+
+		applyImpulse(contact, point, tangent * impulse);
+	}
+
+	// Contacts can only push, so the accumulated impulse is kept positive rather than each pass's
+	for(unsigned i = 0; i < contact.point_count; i++) {
+		SolverPoint& point = contact.points[i];
+		glm::vec2 relative = b.velocity + cross(b.angular_velocity, point.r_b) - a.velocity - cross(a.angular_velocity, point.r_a);
+
+		float impulse = (point.bias - glm::dot(relative, contact.normal)) * point.normal_mass;
+		float total = std::max(point.normal_impulse + impulse, 0.f);
+		impulse = total - point.normal_impulse;
+		point.normal_impulse = total;
+
+		applyImpulse(contact, point, contact.normal * impulse);
+	}
+}
+
+// Like the normal part of solveContact() but on the push velocities, which start from nothing every step
+void ContactSolver::solvePush(SolverContact& contact) {
+	SolverBody& a = solver_bodies[contact.body_a];
+	SolverBody& b = solver_bodies[contact.body_b];
+
+	float impulse = (contact.push_bias - glm::dot(b.push_velocity - a.push_velocity, contact.normal)) * contact.push_mass;
+	float total = std::max(contact.push_impulse + impulse, 0.f);
+	impulse = total - contact.push_impulse;
+	contact.push_impulse = total;
+
+	a.push_velocity -= contact.normal * impulse * a.inv_mass;
+	b.push_velocity += contact.normal * impulse * b.inv_mass;
+}
+
+void ContactSolver::storeImpulses() {
+	for(auto& contact : solver_contacts) {
+		CachedImpulses& cached = impulse_cache[contact.key];
+		cached.point_count = contact.point_count;
+		cached.last_step = step;
+		for(unsigned i = 0; i < contact.point_count; i++) {
+			cached.points[i] = contact.points[i].position;
+			cached.normal_impulse[i] = contact.points[i].normal_impulse;
+			cached.tangent_impulse[i] = contact.points[i].tangent_impulse;
+		}
+	}
+
+	// Pairs that stopped touching start from nothing if they touch again
+	for(auto it = impulse_cache.begin(); it != impulse_cache.end();) {
+		if(it->second.last_step != step)
+			it = impulse_cache.erase(it);
+		else
+			it++;
+	}
+}
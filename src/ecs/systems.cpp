@@ -0,0 +1,61 @@
+#include "ecs/systems.h"
+#include "deterministicMath.h"
+#include "bodyStore.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace ecs;
+
+static constexpr float velocity_max = 25;
+static constexpr float angular_velocity_max = 300;
+
+void ecs::steerShips(World& world) {
+	world.each<Transform, Rigidbody, Ship>([](Transform& transform, Rigidbody& body, Ship& ship) {
+		float s, c;
+		dmath::sinCosDeg(transform.rot + 90, &s, &c);
+
+		body.force += glm::vec2(c, s) * (ship.thrust * ship.thrust_power) - body.velocity * 10.f;
+		body.torque += ship.turn * ship.turn_power - body.angular_velocity * 2;
+
+		body.velocity = glm::clamp(body.velocity, glm::vec2(-velocity_max), glm::vec2(velocity_max));
+		body.angular_velocity = std::clamp(body.angular_velocity, -angular_velocity_max, angular_velocity_max);
+	});
+}
+
+void ecs::integrate(World& world, float deltaTime) {
+	world.each<Transform, Rigidbody>([deltaTime](Transform& transform, Rigidbody& body) {
+		body.velocity += body.force * body.inv_mass * deltaTime;
+		body.angular_velocity += body.torque * body.inv_moi * deltaTime;
+
+		// Snapped to rest the same way, so both stores agree on slow bodies
+		if(std::fabs(body.velocity.x) < BodyStore::rest_velocity)
+			body.velocity.x = 0;
+		if(std::fabs(body.velocity.y) < BodyStore::rest_velocity)
+			body.velocity.y = 0;
+		if(std::fabs(body.angular_velocity) < BodyStore::rest_angular_velocity)
+			body.angular_velocity = 0;
+
+		transform.pos += body.velocity * deltaTime;
+		transform.rot += body.angular_velocity * deltaTime;
+		body.force = glm::vec2(0);
+		body.torque = 0;
+	});
+}
+
+void ecs::updateTransforms(World& world) {
+	world.each<Transform>([](Transform& transform) {
+		transform.world = Affine2d::compose(transform.pos, transform.rot, transform.scl, transform.layer);
+	});
+}
+
+void ecs::updateBounds(World& world) {
+	world.each<Transform, Collider>([](Transform& transform, Collider& collider) {
+		const Affine2d& t = transform.world;
+		float scale = std::sqrt(std::max(t.a * t.a + t.b * t.b, t.c * t.c + t.d * t.d));
+		glm::vec2 center(t.tx, t.ty);
+		glm::vec2 extent(collider.radius * scale);
+		collider.lower_left = center - extent;
+		collider.upper_right = center + extent;
+	});
+}
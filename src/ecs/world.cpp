@@ -0,0 +1,124 @@
+#include "ecs/world.h"
+
+#include <string>
+#include <cstdlib>
+
+using namespace ecs;
+
+World::World() {
+	archetypeFor(0);
+}
+
+std::vector<std::unique_ptr<World::ColumnBase>>& World::prototypes() {
+	static std::vector<std::unique_ptr<ColumnBase>> prototypes;
+	return prototypes;
+}
+
+unsigned World::newComponentId(std::unique_ptr<ColumnBase> prototype) {
+	if(prototypes().size() == max_components) {
+		log("Only " + std::to_string(max_components) + " component types fit in an archetype's mask", CRIT);
+		std::abort();
+	}
+	prototypes().push_back(std::move(prototype));
+	return prototypes().size() - 1;
+}
+
+Entity World::create() {
+	Entity e;
+	if(free_indices.empty()) {
+		e.index = locations.size();
+		locations.emplace_back();
+	} else {
+		e.index = free_indices.back();
+		free_indices.pop_back();
+	}
+
+	Location& location = locations[e.index];
+	e.generation = location.generation;
+	location.archetype = 0;
+	location.row = archetypes[0]->entities.size();
+	archetypes[0]->entities.push_back(e);
+	live++;
+	return e;
+}
+
+void World::destroy(Entity e) {
+	if(!alive(e))
+		return;
+
+	Location& location = locations[e.index];
+	removeRow(*archetypes[location.archetype], location.row);
+	location.generation++;
+	free_indices.push_back(e.index);
+	live--;
+}
+
+bool World::alive(Entity e) const {
+	return e.index < locations.size() && locations[e.index].generation == e.generation;
+}
+
+unsigned World::archetypeFor(uint64_t mask) {
+	auto it = archetype_of_mask.find(mask);
+	if(it != archetype_of_mask.end())
+		return it->second;
+
+	auto archetype = std::make_unique<Archetype>();
+	archetype->mask = mask;
+	for(unsigned id = 0; id < max_components; id++) {
+		archetype->column_of[id] = -1;
+		if(mask & (uint64_t(1) << id)) {
+			archetype->column_of[id] = archetype->columns.size();
+			archetype->columns.push_back(prototypes()[id]->emptyCopy());
+		}
+	}
+
+	unsigned index = archetypes.size();
+	archetypes.push_back(std::move(archetype));
+	archetype_of_mask[mask] = index;
+	return index;
+}
+
+unsigned World::neighbor(unsigned from, unsigned component, bool adding) {
+	auto& edges = adding ? archetypes[from]->with : archetypes[from]->without;
+	auto it = edges.find(component);
+	if(it != edges.end())
+		return it->second;
+
+	uint64_t bit = uint64_t(1) << component;
+	uint64_t mask = adding ? archetypes[from]->mask | bit : archetypes[from]->mask & ~bit;
+	unsigned to = archetypeFor(mask); // May grow archetypes, so edges can't be used past here
+	(adding ? archetypes[from]->with : archetypes[from]->without)[component] = to;
+	return to;
+}
+
+void World::move(Entity e, unsigned to) {
+	Location& location = locations[e.index];
+	Archetype& source = *archetypes[location.archetype];
+	Archetype& destination = *archetypes[to];
+
+	uint64_t shared = source.mask & destination.mask;
+	for(unsigned id = 0; id < max_components; id++) {
+		if(shared & (uint64_t(1) << id))
+			source.columns[source.column_of[id]]->moveRow(location.row, *destination.columns[destination.column_of[id]]);
+	}
+
+	unsigned row = location.row;
+	destination.entities.push_back(e);
+	removeRow(source, row); // Also drops whatever the destination doesn't have
+
+	location.archetype = to;
+	location.row = destination.entities.size() - 1;
+}
+
+// Moves the last row into its place, like the columns do
+void World::removeRow(Archetype& archetype, unsigned row) {
+	for(auto& column : archetype.columns)
+		column->removeRow(row);
+
+	unsigned last = archetype.entities.size() - 1;
+	if(row != last) {
+		archetype.entities[row] = archetype.entities[last];
+		locations[archetype.entities[row].index].row = row;
+	}
+	archetype.entities.pop_back();
+}
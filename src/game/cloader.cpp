@@ -15,14 +15,9 @@ std::vector<glm::ivec2> ChunkLoader::calcChunkCoords(glm::ivec2 offset) {
 
 void ChunkLoader::loadChunksSquare() {
 	glm::vec2 world_pos = getWorldPos(); // Get the position of this chunkloader
-	glm::uvec2 c_size = grid->getChunkSize(); // Get the chunk size of the grid we load
-	glm::uvec2 t_size = grid->getTileSize();
 
 	// Get the chunk coordinate that this loader is in
-	glm::ivec2 now_pos = glm::ivec2(
-		floor((world_pos.x + t_size.x / 2.f) / c_size.x),
-		floor((world_pos.y + t_size.y / 2.f) / c_size.y)
-	);
+	glm::ivec2 now_pos = grid->calcChunkPos(world_pos);
 
 	// Remember what the last chunk we were in was
 	static glm::ivec2 last_pos = glm::ivec2(world_pos.x + radius * 2 + 1, 0); // Initialized so we start by loading everything once
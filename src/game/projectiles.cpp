@@ -0,0 +1,230 @@
+#include "game/projectiles.h"
+#include "object2d.h"
+#include "rigidbody2d.h"
+#include "game/ship.h"
+
+std::vector<ProjectilePool*> ProjectilePool::pools;
+const char* ProjectilePool::default_shader_path_vert = "tests/shader/projectile.vs";
+const char* ProjectilePool::default_shader_path_frag = "tests/shader/sprite.fs";
+
+ProjectilePool::ProjectilePool(ProjectileType type, int layer) :
+	Renderable(defaultShader(), layer),
+	type(type)
+{
+	// Everything is allocated up front, spawning never allocates
+	unsigned capacity = type.capacity;
+	for(auto* array : {&pos_x, &pos_y, &last_x, &last_y, &vel_x, &vel_y, &age})
+		array->resize(capacity);
+	owners.resize(capacity);
+	dead.resize(capacity);
+	instances.resize(capacity);
+	hits.reserve(capacity);
+
+	texture = loadTexture(type.sprite_path);
+	mesh = Primitive::rect(type.size, glm::vec2(0));
+	init_buffers();
+
+	pools.push_back(this);
+}
+
+ProjectilePool::~ProjectilePool() {
+	pools.erase(std::find(pools.begin(), pools.end(), this));
+	glDeleteBuffers(1, &VBO);
+	glDeleteBuffers(1, &EBO);
+	glDeleteBuffers(1, &IBO);
+	glDeleteVertexArrays(1, &VAO);
+}
+
+Shader* ProjectilePool::defaultShader() {
+	static Shader shader(default_shader_path_vert, default_shader_path_frag);
+	return register_shader(&shader);
+}
+
+ProjectilePool* ProjectilePool::find(const std::string& type_name) {
+	for(ProjectilePool* pool : pools) {
+		if(pool->type.name == type_name)
+			return pool;
+	}
+	return nullptr;
+}
+
+bool ProjectilePool::spawn(glm::vec2 position, glm::vec2 velocity, Collider* owner) {
+	if(count == type.capacity)
+		return false;
+
+	unsigned i = count++;
+	pos_x[i] = last_x[i] = position.x;
+	pos_y[i] = last_y[i] = position.y;
+	vel_x[i] = velocity.x;
+	vel_y[i] = velocity.y;
+	age[i] = 0;
+	owners[i] = owner;
+	dead[i] = false;
+	return true;
+}
+
+void ProjectilePool::clear() {
+	count = 0;
+	hits.clear();
+}
+
+unsigned ProjectilePool::size() const {
+	return count;
+}
+
+const std::vector<ProjectileHit>& ProjectilePool::getHits() const {
+	return hits;
+}
+
+// Moves the last projectile into this one's place
+void ProjectilePool::remove(unsigned index) {
+	unsigned last = --count;
+	if(index == last)
+		return;
+
+	pos_x[index] = pos_x[last];
+	pos_y[index] = pos_y[last];
+	last_x[index] = last_x[last];
+	last_y[index] = last_y[last];
+	vel_x[index] = vel_x[last];
+	vel_y[index] = vel_y[last];
+	age[index] = age[last];
+	owners[index] = owners[last];
+	dead[index] = dead[last];
+}
+
+// Raycasts the path this projectile is about to take
+bool ProjectilePool::findHit(unsigned index, float deltaTime, RaycastHit* hit) {
+	glm::vec2 origin(pos_x[index], pos_y[index]);
+	glm::vec2 velocity(vel_x[index], vel_y[index]);
+	float distance = glm::length(velocity) * deltaTime;
+	if(distance == 0)
+		return false;
+
+	if(!Collider::raycast(origin, velocity, distance, hit, type.mask))
+		return false;
+	if(hit->collider != owners[index])
+		return true;
+
+	// Rare, only while leaving the owner. Take whatever is behind it instead
+	Collider::raycastAll(origin, velocity, distance, owner_hits, type.mask);
+	for(auto& other : owner_hits) {
+		if(other.collider != owners[index]) {
+			*hit = other;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ProjectilePool::update(float deltaTime) {
+	hits.clear();
+
+	// Collide first, against where they're headed this tick
+	for(unsigned i = 0; i < count; i++) {
+		RaycastHit hit;
+		dead[i] = age[i] >= type.lifetime;
+		if(dead[i] || !findHit(i, deltaTime, &hit))
+			continue;
+
+		glm::vec2 velocity(vel_x[i], vel_y[i]);
+		hits.push_back({hit.collider, hit.point, hit.normal, velocity, type.damage});
+		dead[i] = true;
+
+		if(hit.collider->body && !hit.collider->is_static)
+			hit.collider->body->applyImpulse(velocity * type.mass, hit.point);
+	}
+
+	// Then integrate everything in one go, dead ones included, it's cheaper than branching
+	for(unsigned i = 0; i < count; i++) {
+		last_x[i] = pos_x[i];
+		last_y[i] = pos_y[i];
+		pos_x[i] += vel_x[i] * deltaTime;
+		pos_y[i] += vel_y[i] * deltaTime;
+		age[i] += deltaTime;
+	}
+
+	// Backwards, so a swapped in projectile has already been checked
+	for(unsigned i = count; i-- > 0;) {
+		if(dead[i])
+			remove(i);
+	}
+}
+
+void ProjectilePool::updateAll(float deltaTime) {
+	for(ProjectilePool* pool : pools) {
+		pool->update(deltaTime);
+		Ship::applyHits(pool->getHits());
+	}
+}
+
+void Weapon::update(glm::vec2 position, glm::vec2 direction, glm::vec2 velocity, Collider* owner) {
+	if(cooldown > 0)
+		cooldown--;
+	if(!trigger || cooldown > 0 || !pool)
+		return;
+
+	if(pool->spawn(position, velocity + direction * muzzle_speed, owner))
+		cooldown = cooldown_ticks;
+}
+
+void ProjectilePool::init_buffers() {
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+	glGenBuffers(1, &IBO);
+
+	glBindVertexArray(VAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(Vertex2d), &mesh.vertices[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned), &mesh.indices[0], GL_STATIC_DRAW);
+
+	// vertex positions
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex2d), (void*)0);
+
+	// vertex texture coords
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex2d), (void*)offsetof(Vertex2d, tex));
+
+	// Per projectile position and facing, sized for a full pool once so draws only ever update it
+	glBindBuffer(GL_ARRAY_BUFFER, IBO);
+	glBufferData(GL_ARRAY_BUFFER, type.capacity * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(2);
+	glVertexAttribDivisor(2, 1);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+
+	glBindVertexArray(0);
+}
+
+void ProjectilePool::draw(Shader& shader) {
+	if(count == 0)
+		return;
+
+	float alpha = Object2d::tick_alpha;
+	for(unsigned i = 0; i < count; i++) {
+		glm::vec2 position = glm::mix(glm::vec2(last_x[i], last_y[i]), glm::vec2(pos_x[i], pos_y[i]), alpha);
+		glm::vec2 velocity(vel_x[i], vel_y[i]);
+		glm::vec2 facing = velocity == glm::vec2(0) ? glm::vec2(0, 1) : glm::normalize(velocity);
+		instances[i] = glm::vec4(position.x, position.y, facing.x, facing.y);
+	}
+
+	unsigned tex_unit = GL_TEXTURE0;
+	glActiveTexture(tex_unit);
+	glBindTexture(GL_TEXTURE_2D, texture.glID);
+	shader.set("sprite", (int)tex_unit);
+	shader.set("layer", getLayer());
+
+	glBindBuffer(GL_ARRAY_BUFFER, IBO);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::vec4), &instances[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glBindVertexArray(VAO);
+	glDrawElementsInstanced(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, nullptr, count);
+
+	// Cleanup
+	glBindVertexArray(0);
+	glActiveTexture(GL_TEXTURE0);
+}
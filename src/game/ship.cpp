@@ -1,8 +1,24 @@
 #include "game/ship.h"
 
+#include <algorithm>
+
 std::vector<ShipClass> Ship::ship_classes;
 std::vector<Ship*> Ship::ships;
 
+ShipClass ShipClass::fromJson(const Json::Value& j) {
+	ShipClass c;
+	c.name = j.get("name", "").asString();
+	c.sprite_path = j.get("sprite", "").asString();
+	c.mass = j.get("mass", 1).asFloat();
+	c.thrust_power = j.get("thrust_power", 0).asFloat();
+	c.turn_power = j.get("turn_power", 0).asFloat();
+	c.weapon_slots = j.get("weapon_slots", 0).asUInt();
+	c.collision = j["collision"];
+	c.hull_vertices = j.get("hull_vertices", HullBaker::default_vertex_budget).asUInt();
+	c.health = j.get("health", 100).asFloat();
+	return c;
+}
+
 Ship::Ship(std::string id, std::string class_name) : 
 	Object2d(id)
 {
@@ -11,16 +27,15 @@ Ship::Ship(std::string id, std::string class_name) :
 	});
 
 	ship_class = *ship_class_it;
+	health = ship_class.health;
 	ships.push_back(this);
 
 	take(newObj<Sprite>("sprite", ship_class.sprite_path));
 
-	const std::vector<glm::vec2>& sprite_mesh = extractStructField(
-		get<Sprite>("sprite").mesh.vertices, 
-		&Vertex2d::pos
-	);
-	auto collider = std::make_unique<MeshCollider>("collider", sprite_mesh);
-	take(newObj<Rigidbody2d>("rigidbody", sprite_mesh, ship_class.mass));
+	// The sprite's mesh covers the whole image, the baked hull only covers the ship
+	std::vector<glm::vec2> hull = HullBaker::load(ship_class.sprite_path, ship_class.hull_vertices);
+	take(newObj<Rigidbody2d>("rigidbody", hull, ship_class.mass));
+	rigidbody->collider->loadFilter(ship_class.collision);
 }
 
 Ship::~Ship() {
@@ -33,40 +48,65 @@ glm::vec2 safeNormal(glm::vec2 in) {
 	return glm::normalize(in);
 }
 
+void Ship::clearControls() {
+	thrust = 0;
+	turn = 0;
+	weapon.trigger = false;
+}
+
 void Ship::update(float deltaTime) {
-	Rigidbody2d& body = get<Rigidbody2d>("rigidbody");
-	if(body.velocity != glm::vec2(0))
-		body.applyForce(-body.velocity * 10.f);
+	Rigidbody2d& body = *rigidbody;
+	body.applyForce(up() * std::clamp(thrust, -1.f, 1.f) * ship_class.thrust_power);
+	body.applyTorque(std::clamp(turn, -1.f, 1.f) * ship_class.turn_power);
+
+	glm::vec2 velocity = body.getVelocity();
+	float angular_velocity = body.getAngularVelocity();
+	if(velocity != glm::vec2(0))
+		body.applyForce(-velocity * 10.f);
 	
 	// yummy branches
 	int rotation_sign;
-	if(body.angular_velocity == 0)
+	if(angular_velocity == 0)
 		rotation_sign = 0;
-	else if(body.angular_velocity > 0)
+	else if(angular_velocity > 0)
 		rotation_sign = -1;
 	else
 		rotation_sign = 1;
 
-	body.applyTorque(-body.angular_velocity * 2);
+	body.applyTorque(-angular_velocity * 2);
 
-	if(body.velocity.x > VELOCITY_MAX)
-		body.velocity.x = VELOCITY_MAX;
-	if(body.velocity.x < -VELOCITY_MAX)
-		body.velocity.x = -VELOCITY_MAX;
+	if(velocity.x > VELOCITY_MAX)
+		velocity.x = VELOCITY_MAX;
+	if(velocity.x < -VELOCITY_MAX)
+		velocity.x = -VELOCITY_MAX;
 		
-	if(body.velocity.y > VELOCITY_MAX)
-		body.velocity.y = VELOCITY_MAX;
-	if(body.velocity.y < -VELOCITY_MAX)
-		body.velocity.y = -VELOCITY_MAX;
+	if(velocity.y > VELOCITY_MAX)
+		velocity.y = VELOCITY_MAX;
+	if(velocity.y < -VELOCITY_MAX)
+		velocity.y = -VELOCITY_MAX;
 		
-	if(body.angular_velocity > ROT_VELOCITY_MAX)
-		body.angular_velocity = ROT_VELOCITY_MAX;
-	if(body.angular_velocity < -ROT_VELOCITY_MAX)
-		body.angular_velocity = -ROT_VELOCITY_MAX;
+	if(angular_velocity > ROT_VELOCITY_MAX)
+		angular_velocity = ROT_VELOCITY_MAX;
+	if(angular_velocity < -ROT_VELOCITY_MAX)
+		angular_velocity = -ROT_VELOCITY_MAX;
+
+	body.setVelocity(velocity);
+	body.setAngularVelocity(angular_velocity);
+
+	weapon.update(getWorldPos() + up(), up(), velocity, body.collider.get());
 }
 
 void Ship::updateShips(float deltaTime) {
 	for(auto ship : ships) {
 		ship->update(deltaTime);
 	}
+}
+
+void Ship::applyHits(const std::vector<ProjectileHit>& hits) {
+	for(const ProjectileHit& hit : hits) {
+		Rigidbody2d* body = hit.collider->body;
+		Ship* ship = body && body->parent ? body->parent->tryAs<Ship>() : nullptr;
+		if(ship)
+			ship->health = std::max(ship->health - hit.damage, 0.f);
+	}
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 const char* TileGrid::default_shader_path_vert = "tests/shader/sprite.vs";
 const char* TileGrid::default_shader_path_frag = "tests/shader/sprite.fs";
+const TileGrid::ChunkColliders TileGrid::no_colliders = { {}, {}, false };
 
 // TileGrid Member Functions /////////////////////////////////////////////////////
 
@@ -24,6 +25,10 @@ TileGrid::TileGrid(std::string path, unsigned chunk_slots, int layer) :
 	initBuffers(chunk_slots);
 }
 
+TileGrid::~TileGrid() {
+	Collider::removeStaticSource(this);
+}
+
 Shader* TileGrid::defaultShader() {
 	static Shader shader(default_shader_path_vert, default_shader_path_frag);
 	return register_shader(&shader);
@@ -89,8 +94,12 @@ TileGrid::Chunk* TileGrid::addChunk(glm::ivec2 position, TileSet tiles, unsigned
 			file_size
 		});
 
+		chunk_min = glm::min(chunk_min, position);
+		chunk_max = glm::max(chunk_max, position);
+		markCollidersDirty(position);
 		return &chunks.front();
 	} else {
+		markCollidersDirty(position);
 		chunk->tiles = tiles;
 		chunk->tile_index = file_pos;
 		chunk->tile_count = file_size;
@@ -128,7 +137,7 @@ TileGrid::Chunk* TileGrid::getChunkFromGridPos(glm::ivec2 chunk_pos) {
 TileGrid::Chunk* TileGrid::addTileToGrid(glm::vec2 pos, unsigned tileID, unsigned attribs) {
 	Chunk* chunk = getChunk(pos);
 
-	glm::ivec2 tile_pos = glm::ivec2(std::round(pos.x), std::round(pos.y)); // Absolute position in the grid
+	glm::ivec2 tile_pos = calcTilePos(pos); // Absolute position in the grid
 	tile_pos.x %= chunk_size.x * ((tile_pos.x < 0) ? -1 : 1);
 	tile_pos.y %= chunk_size.y * ((tile_pos.y < 0) ? -1 : 1);
 
@@ -139,7 +148,7 @@ TileGrid::Chunk* TileGrid::addTileToGrid(glm::vec2 pos, unsigned tileID, unsigne
 TileGrid::Chunk* TileGrid::removeTileFromGrid(glm::vec2 pos) {
 	Chunk* chunk = getChunk(pos);
 
-	glm::ivec2 tile_pos = glm::ivec2(std::round(pos.x), std::round(pos.y)); // Absolute position in the grid
+	glm::ivec2 tile_pos = calcTilePos(pos); // Absolute position in the grid
 	tile_pos.x %= chunk_size.x * ((tile_pos.x < 0) ? -1 : 1);
 	tile_pos.y %= chunk_size.y * ((tile_pos.y < 0) ? -1 : 1);
 
@@ -157,6 +166,7 @@ void TileGrid::addTileToChunk(Chunk* chunk, glm::ivec2 position, unsigned tileID
 		position.y % chunk_size.y
 	);
 	chunk->tiles.insert({ tileID, pos_in_chunk, attribs });
+	markCollidersDirty(chunk->pos);
 }
 
 void TileGrid::removeTileFromChunk(Chunk* chunk, glm::ivec2 position) {
@@ -168,17 +178,242 @@ void TileGrid::removeTileFromChunk(Chunk* chunk, glm::ivec2 position) {
 	if(it != chunk->tiles.end()) {
 		// If a tile is found, erase it first
 		chunk->tiles.erase(it);
+		markCollidersDirty(chunk->pos);
 	} 
 }
 
 glm::ivec2 TileGrid::calcChunkPos(glm::vec2 world_pos) {
 	glm::ivec2 chunk_pos = glm::ivec2(
-		floor((world_pos.x + tile_size.x / 2.f) / chunk_size.x),
-		floor((world_pos.y + tile_size.y / 2.f) / chunk_size.y)
+		floor((world_pos.x / tilePitch().x + 0.5f) / chunk_size.x),
+		floor((world_pos.y / tilePitch().y + 0.5f) / chunk_size.y)
 	);
 	return chunk_pos;
 }
 
+glm::ivec2 TileGrid::calcTilePos(glm::vec2 world_pos) {
+	return glm::ivec2(
+		floor(world_pos.x / tilePitch().x + 0.5f),
+		floor(world_pos.y / tilePitch().y + 0.5f)
+	);
+}
+
+glm::vec2 TileGrid::tilePitch() const {
+	// A grid that failed to load has a tile size of 0, its tiles still need somewhere to go
+	return glm::max(glm::vec2(tile_size), glm::vec2(1));
+}
+
+TileGrid::Chunk* TileGrid::findChunk(glm::ivec2 chunk_pos) {
+	auto chunk_it = std::find_if(chunks.begin(), chunks.end(), [chunk_pos](const Chunk& c){
+		return c.pos == chunk_pos;
+	});
+
+	if(chunk_it == chunks.end())
+		return nullptr;
+	return &(*chunk_it);
+}
+
+uint64_t TileGrid::chunkKey(glm::ivec2 chunk_pos) {
+	return ((uint64_t)(uint32_t)chunk_pos.x << 32) | (uint32_t)chunk_pos.y;
+}
+
+void TileGrid::markCollidersDirty(glm::ivec2 chunk_pos) {
+	chunk_colliders[chunkKey(chunk_pos)].dirty = true; // Only called for chunks that exist, so this never adds an empty entry
+}
+
+const std::vector<std::shared_ptr<MeshCollider>>& TileGrid::getChunkColliders(glm::ivec2 chunk_pos) {
+	return getChunkEntry(chunk_pos).colliders;
+}
+
+const TileGrid::ChunkColliders& TileGrid::getChunkEntry(glm::ivec2 chunk_pos) {
+	// Every chunk has an entry from when addChunk() marked it dirty, so anything missing has no chunk.
+	// Rays and queries pass through a lot of empty space, none of it gets an entry of its own
+	auto it = chunk_colliders.find(chunkKey(chunk_pos));
+	if(it == chunk_colliders.end())
+		return no_colliders;
+
+	ChunkColliders& entry = it->second;
+	if(entry.dirty) {
+		Chunk* chunk = findChunk(chunk_pos);
+		if(chunk == nullptr) { // Shouldn't happen, but don't keep asking
+			entry.colliders.clear();
+			entry.cells.clear();
+			entry.dirty = false;
+		} else {
+			buildColliders(*chunk, entry);
+		}
+	}
+
+	return entry;
+}
+
+void TileGrid::queryStatic(const BoundingBox& region, std::vector<Collider*>& result) {
+	glm::ivec2 lower = calcChunkPos(region.lower_left);
+	glm::ivec2 upper = calcChunkPos(region.upper_right);
+
+	for(int x = lower.x; x <= upper.x; x++) {
+		for(int y = lower.y; y <= upper.y; y++) {
+			for(auto& collider : getChunkColliders(glm::ivec2(x, y)))
+				result.push_back(collider.get());
+		}
+	}
+}
+
+// Walks the tiles the ray passes through in order (DDA), raycasting the collider of each solid one it meets.
+// A collider can't be hit before the first of its tiles is entered, so the walk stops once it passes the clip distance
+void TileGrid::raycastStatic(glm::vec2 origin, glm::vec2 direction, float max_distance, const std::function<float(const RaycastHit&)>& callback) {
+	const float infinity = std::numeric_limits<float>::infinity();
+
+	// Walk in tile units, where tile x covers x - 0.5 to x + 0.5. Scaling the direction the same way keeps distances the same
+	glm::vec2 tile_origin = origin / tilePitch();
+	glm::vec2 tile_direction = direction / tilePitch();
+
+	// Nothing is outside the box around the chunks. Start where the ray enters it and stop once it leaves, so a
+	// far away origin or an infinite max_distance doesn't walk through empty space forever
+	if(chunk_min.x > chunk_max.x)
+		return;
+	glm::ivec2 chunk_size_i(chunk_size);
+	glm::ivec2 lower_tile = chunk_min * chunk_size_i;
+	glm::ivec2 upper_tile = (chunk_max + 1) * chunk_size_i - 1;
+
+	float enter = 0, leave = max_distance;
+	for(int axis = 0; axis < 2; axis++) {
+		float lower = lower_tile[axis] - 0.5f, upper = upper_tile[axis] + 0.5f;
+		if(tile_direction[axis] == 0) {
+			if(tile_origin[axis] < lower || tile_origin[axis] > upper)
+				return;
+			continue;
+		}
+		float t1 = (lower - tile_origin[axis]) / tile_direction[axis];
+		float t2 = (upper - tile_origin[axis]) / tile_direction[axis];
+		enter = std::max(enter, std::min(t1, t2));
+		leave = std::min(leave, std::max(t1, t2));
+	}
+	if(enter > leave)
+		return;
+
+	glm::vec2 start = tile_origin + tile_direction * enter;
+	glm::ivec2 tile = glm::clamp(glm::ivec2(std::floor(start.x + 0.5f), std::floor(start.y + 0.5f)), lower_tile, upper_tile);
+	glm::ivec2 step(direction.x > 0 ? 1 : -1, direction.y > 0 ? 1 : -1);
+
+	// Distance along the ray to the next tile edge on each axis, and between edges
+	glm::vec2 next(
+		direction.x != 0 ? (tile.x + step.x * 0.5f - tile_origin.x) / tile_direction.x : infinity,
+		direction.y != 0 ? (tile.y + step.y * 0.5f - tile_origin.y) / tile_direction.y : infinity
+	);
+	glm::vec2 delta(
+		direction.x != 0 ? std::abs(1 / tile_direction.x) : infinity,
+		direction.y != 0 ? std::abs(1 / tile_direction.y) : infinity
+	);
+
+	glm::ivec2 chunk_pos;
+	const ChunkColliders* entry = nullptr;
+	Collider* last = nullptr; // Tiles of the same rectangle are passed through one after another
+
+	float distance = enter;
+	while(distance <= max_distance && tile.x >= lower_tile.x && tile.x <= upper_tile.x && tile.y >= lower_tile.y && tile.y <= upper_tile.y) {
+		glm::ivec2 current_chunk(
+			(int)std::floor((float)tile.x / chunk_size_i.x),
+			(int)std::floor((float)tile.y / chunk_size_i.y)
+		);
+		if(entry == nullptr || current_chunk != chunk_pos) {
+			chunk_pos = current_chunk;
+			entry = &getChunkEntry(chunk_pos);
+		}
+
+		if(!entry->cells.empty()) {
+			glm::ivec2 local = tile - chunk_pos * chunk_size_i;
+			int index = entry->cells[local.y * chunk_size_i.x + local.x];
+			Collider* collider = index >= 0 ? entry->colliders[index].get() : nullptr;
+
+			if(collider && collider != last) {
+				last = collider;
+				RaycastHit hit;
+				if(collider->raycastShape(origin, direction, max_distance, &hit))
+					max_distance = std::min(max_distance, callback(hit));
+			}
+		}
+
+		if(next.x < next.y) {
+			distance = next.x;
+			next.x += delta.x;
+			tile.x += step.x;
+		} else {
+			distance = next.y;
+			next.y += delta.y;
+			tile.y += step.y;
+		}
+	}
+}
+
+// Greedily merges the chunk's tiles into rectangles. Each one starts at the first free tile in row order,
+// grows as wide as the row allows, then grows upwards while every tile across its width is free
+void TileGrid::buildColliders(const Chunk& chunk, ChunkColliders& entry) {
+	entry.colliders.clear();
+	entry.cells.clear();
+	entry.dirty = false;
+
+	std::vector<bool> solid(chunk_size.x * chunk_size.y, false);
+	auto index = [this](unsigned x, unsigned y) {
+		return y * chunk_size.x + x;
+	};
+
+	for(auto& tile : chunk.tiles) {
+		if(tile.pos.x < 0 || tile.pos.y < 0 || tile.pos.x >= (int)chunk_size.x || tile.pos.y >= (int)chunk_size.y)
+			continue; // Outside of the chunk, nothing draws it either
+		solid[index(tile.pos.x, tile.pos.y)] = true;
+	}
+
+	glm::vec2 chunk_offset = glm::vec2(chunk.pos.x * (int)chunk_size.x, chunk.pos.y * (int)chunk_size.y);
+	glm::vec2 half_tile = glm::vec2(tile_size) / 2.f;
+
+	for(unsigned y = 0; y < chunk_size.y; y++) {
+		for(unsigned x = 0; x < chunk_size.x; x++) {
+			if(!solid[index(x, y)])
+				continue;
+
+			unsigned width = 1;
+			while(x + width < chunk_size.x && solid[index(x + width, y)])
+				width++;
+
+			unsigned height = 1;
+			while(y + height < chunk_size.y) {
+				bool row_solid = true;
+				for(unsigned i = x; i < x + width && row_solid; i++)
+					row_solid = solid[index(i, y + height)];
+
+				if(!row_solid)
+					break;
+				height++;
+			}
+
+			// Take these tiles so they aren't merged again
+			if(entry.cells.empty())
+				entry.cells.assign(chunk_size.x * chunk_size.y, -1);
+			for(unsigned j = y; j < y + height; j++) {
+				for(unsigned i = x; i < x + width; i++) {
+					solid[index(i, j)] = false;
+					entry.cells[index(i, j)] = entry.colliders.size();
+				}
+			}
+
+			// Tiles are centered on their position, same as in updateVBO()
+			glm::vec2 lower = (chunk_offset + glm::vec2(x, y)) * tilePitch() - half_tile;
+			glm::vec2 upper = (chunk_offset + glm::vec2(x + width - 1, y + height - 1)) * tilePitch() + half_tile;
+
+			auto collider = std::make_shared<MeshCollider>("tile_collider", std::vector<glm::vec2>{
+				lower,
+				glm::vec2(upper.x, lower.y),
+				upper,
+				glm::vec2(lower.x, upper.y)
+			}, true);
+
+			// Static colliders never move, so their transform and bounds only need to be found once
+			collider->updateTransform();
+			collider->updateBounds();
+			entry.colliders.push_back(collider);
+		}
+	}
+}
 
 void TileGrid::initBuffers(unsigned slot_count) {
 	// Create buffers
@@ -256,14 +491,14 @@ void TileGrid::updateVBO(unsigned VBO) {
 		}
 
 		auto basis = tex->second.getTileBasis(tile->tileID - tex->first);
-		Polygon tile_mesh = Primitive::rect(tile_size, tile->pos)
+		Polygon tile_mesh = Primitive::rect(tile_size, glm::vec2(tile->pos) * tilePitch())
 			.setOptions(tile->attribs)
 			.setBasis(basis[0], basis[1])
 			.regenTexCoords();
 
 		for(Vertex2d& vert : tile_mesh.vertices) {
-			vert.pos.x += chunk->pos.x * (int)chunk_size.x;
-			vert.pos.y += chunk->pos.y * (int)chunk_size.y;
+			vert.pos.x += chunk->pos.x * (int)chunk_size.x * tilePitch().x;
+			vert.pos.y += chunk->pos.y * (int)chunk_size.y * tilePitch().y;
 		}
 
 		chunk_verts.insert(chunk_verts.end(), tile_mesh.vertices.begin(), tile_mesh.vertices.end());
@@ -420,6 +655,7 @@ bool TileGrid::loadFile(std::string path) {
 
 	// If we've succeeded so far, clear any data the grid might have
 	textures.clear();
+	chunk_colliders.clear(); // The tile size might change, every chunk needs new colliders
 
 	for(auto tex : pb.textures()) {
 		unsigned offset = tex.offset();
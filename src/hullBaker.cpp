@@ -0,0 +1,207 @@
+#include "hullBaker.h"
+
+#include "stb_image.h"
+#include "json/json.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+unsigned char HullBaker::alpha_threshold = 128;
+unsigned HullBaker::default_vertex_budget = 8;
+std::map<std::string, std::vector<glm::vec2>> HullBaker::baked;
+
+static const int cache_version = 1;
+
+static float cross(glm::vec2 a, glm::vec2 b) {
+	return a.x * b.y - a.y * b.x;
+}
+
+static std::vector<glm::vec2> fullRect() {
+	return { glm::vec2(-0.5f, -0.5f), glm::vec2(0.5f, -0.5f), glm::vec2(0.5f, 0.5f), glm::vec2(-0.5f, 0.5f) };
+}
+
+std::string HullBaker::cachePath(const std::string& image_path) {
+	return image_path + ".hull.json";
+}
+
+std::vector<glm::vec2> HullBaker::load(const std::string& image_path, unsigned vertex_budget) {
+	std::string key = image_path + "#" + std::to_string(vertex_budget);
+	auto it = baked.find(key);
+	if(it != baked.end())
+		return it->second;
+
+	std::vector<glm::vec2> hull;
+	if(!readCache(image_path, vertex_budget, &hull))
+		hull = bake(image_path, vertex_budget);
+
+	baked[key] = hull;
+	return hull;
+}
+
+std::vector<glm::vec2> HullBaker::bake(const std::string& image_path, unsigned vertex_budget) {
+	int width, height, components;
+	stbi_set_flip_vertically_on_load(true); // Row 0 at the bottom, the same as loadTexture()
+	unsigned char* data = stbi_load(image_path.c_str(), &width, &height, &components, 4);
+	if(!data) {
+		log("Couldn't read \"" + image_path + "\" to bake a hull, using its rectangle", WARN);
+		return fullRect();
+	}
+
+	// Only the outer corners of the first and last solid pixel in each row can be on the hull
+	std::vector<glm::vec2> points;
+	for(int y = 0; y < height; y++) {
+		const unsigned char* row = data + (size_t)y * width * 4;
+		int first = -1, last = -1;
+		for(int x = 0; x < width; x++) {
+			if(row[x * 4 + 3] >= alpha_threshold) {
+				if(first == -1)
+					first = x;
+				last = x;
+			}
+		}
+
+		if(first == -1)
+			continue;
+		points.emplace_back(first, y);
+		points.emplace_back(first, y + 1);
+		points.emplace_back(last + 1, y);
+		points.emplace_back(last + 1, y + 1);
+	}
+	stbi_image_free(data);
+
+	if(points.empty()) {
+		log("\"" + image_path + "\" has no solid pixels to bake a hull from, using its rectangle", WARN);
+		return fullRect();
+	}
+
+	std::vector<glm::vec2> hull = convexHull(points);
+	simplify(hull, vertex_budget);
+
+	// Pixels to the sprite's space
+	for(glm::vec2& point : hull)
+		point = point / glm::vec2(width, height) - glm::vec2(0.5f);
+
+	writeCache(image_path, vertex_budget, hull);
+	return hull;
+}
+
+bool HullBaker::readCache(const std::string& image_path, unsigned vertex_budget, std::vector<glm::vec2>* hull) {
+	std::string path = cachePath(image_path);
+	std::error_code error;
+	auto cache_time = std::filesystem::last_write_time(path, error);
+	if(error)
+		return false;
+	auto image_time = std::filesystem::last_write_time(image_path, error);
+	if(error || cache_time < image_time)
+		return false; // The image changed since the cache was written
+
+	std::ifstream file(path);
+	Json::Value j;
+	try {
+		file >> j;
+	} catch(const Json::Exception&) {
+		log("Hull cache \"" + path + "\" is corrupt, baking it again", WARN);
+		return false;
+	}
+
+	if(j.get("version", 0).asInt() != cache_version ||
+	   j.get("vertex_budget", 0).asUInt() != vertex_budget ||
+	   j.get("alpha_threshold", 0).asUInt() != alpha_threshold)
+		return false;
+
+	hull->clear();
+	for(const Json::Value& point : j["points"])
+		hull->emplace_back(point[0].asFloat(), point[1].asFloat());
+	return hull->size() >= 3;
+}
+
+void HullBaker::writeCache(const std::string& image_path, unsigned vertex_budget, const std::vector<glm::vec2>& hull) {
+	Json::Value j;
+	j["version"] = cache_version;
+	j["vertex_budget"] = vertex_budget;
+	j["alpha_threshold"] = alpha_threshold;
+	for(glm::vec2 point : hull) {
+		Json::Value p;
+		p.append(point.x);
+		p.append(point.y);
+		j["points"].append(p);
+	}
+
+	std::string path = cachePath(image_path);
+	std::ofstream file(path);
+	if(!(file << j))
+		log("Unable to write hull cache \"" + path + "\"", WARN); // Not fatal, it'll just be baked again next time
+}
+
+// Andrew's monotone chain
+std::vector<glm::vec2> HullBaker::convexHull(std::vector<glm::vec2> points) {
+	std::sort(points.begin(), points.end(), [](const glm::vec2& a, const glm::vec2& b) {
+		return a.x < b.x || (a.x == b.x && a.y < b.y);
+	});
+	points.erase(std::unique(points.begin(), points.end()), points.end());
+	if(points.size() < 3)
+		return points;
+
+	std::vector<glm::vec2> hull(points.size() * 2);
+	unsigned k = 0;
+	for(unsigned i = 0; i < points.size(); i++) { // Lower half
+		while(k >= 2 && cross(hull[k - 1] - hull[k - 2], points[i] - hull[k - 2]) <= 0)
+			k--;
+		hull[k++] = points[i];
+	}
+	for(int i = points.size() - 2, lower = k + 1; i >= 0; i--) { // Upper half
+		while(k >= (unsigned)lower && cross(hull[k - 1] - hull[k - 2], points[i] - hull[k - 2]) <= 0)
+			k--;
+		hull[k++] = points[i];
+	}
+
+	hull.resize(k - 1); // The last point is the first one again
+	return hull;
+}
+
+// Removes edges until the hull fits the budget. Each removed edge is replaced by extending its neighbors until they
+// meet, which only ever grows the hull, so it still contains every solid pixel. The edge that adds the least area goes first
+void HullBaker::simplify(std::vector<glm::vec2>& hull, unsigned vertex_budget) {
+	vertex_budget = std::max(vertex_budget, 3u);
+
+	while(hull.size() > vertex_budget) {
+		unsigned count = hull.size();
+		unsigned best = count;
+		float best_area = std::numeric_limits<float>::max();
+		glm::vec2 best_point;
+
+		for(unsigned i = 0; i < count; i++) {
+			glm::vec2 before = hull[(i + count - 1) % count];
+			glm::vec2 a = hull[i];
+			glm::vec2 b = hull[(i + 1) % count];
+			glm::vec2 after = hull[(i + 2) % count];
+
+			// Where the edge into a, carried on past a, meets the edge out of b, carried back past b
+			glm::vec2 d1 = a - before;
+			glm::vec2 d2 = b - after;
+			float denominator = cross(d1, d2);
+			if(denominator == 0)
+				continue; // Parallel, they never meet
+			float t = cross(b - a, d2) / denominator;
+			float s = cross(b - a, d1) / denominator;
+			if(t <= 0 || s <= 0)
+				continue; // They meet behind the edge, the corners turn too far for this edge to go
+
+			glm::vec2 point = a + d1 * t;
+			float area = std::abs(cross(point - a, b - a)) / 2;
+			if(area < best_area) {
+				best_area = area;
+				best = i;
+				best_point = point;
+			}
+		}
+
+		if(best == count)
+			break; // Every edge is boxed in by its neighbors, like a rectangle's
+
+		hull[best] = best_point;
+		hull.erase(hull.begin() + (best + 1) % count);
+	}
+}
@@ -1,6 +1,9 @@
 #include "main.h"
 #include "rigidbody2d.h"
 #include "collider.h"
+#include "scheduler.h"
+#include "collisionEvents.h"
+#include "game/projectiles.h"
 
 bool show_debug_menu = true;
 
@@ -18,6 +21,8 @@ int main() {
 	float deltaTime = 0.0f;
 	float lastFrame = 0.0f;
 
+	Scheduler simulation(60, 5);
+
 	// Testing zone /////////////////////////////////////////
 
 	GridEditor::init();
@@ -56,19 +61,24 @@ int main() {
 
 	TileGrid grid = gridTest();
 	GridEditor::grid = &grid;
+	Collider::addStaticSource(&grid);
 
-	Ship::ship_classes.push_back({
-		"testclass",
-		"tests/textures/ship.png",
-		5,
-		150,
-		500,
-		0
-	});
+	if(!loadGameConfig(std::string(CONFIG_PATH) + "/game.json")) {
+		cleanup(window);
+		return 1;
+	}
 
 	PlayerShip player;
 	player.take(newObj<ChunkLoader>("chunk_loader", &grid, 1));
 	player.takeFromRef(cam_temp);
+
+	ProjectileType bullet_type;
+	bullet_type.name = "test_bullet";
+	bullet_type.sprite_path = "tests/img/tex.png";
+	bullet_type.capacity = 20000;
+	ProjectilePool bullets(bullet_type);
+	player.weapon.pool = &bullets;
+	player.weapon.cooldown_ticks = 3;
 	
 	//////////////////////////////////////////////
 	Input control;
@@ -86,21 +96,27 @@ int main() {
 	// 	GLFW_KEY_SPACE, INPUT_RELEASE
 	// );
 
+	control.addBind("fire", [&player](){
+		player.weapon.trigger = true;
+	}, GLFW_KEY_SPACE);
+
 	control.addBind("test", [&anim_test](){
 		anim_test.nextFrame();
 	}, GLFW_KEY_P, INPUT_ONCE);
 
-	control.addBind("push", [&test](){
-		test["AAA"]->as<Rigidbody2d>()->applyForce(glm::vec2(0,1));
+	// Held binds only say which way to push, the force is applied once per tick
+	glm::vec2 push(0);
+	control.addBind("push", [&push](){
+		push.y += 1;
 	}, GLFW_KEY_UP);
-	control.addBind("push2", [&test](){
-		test["AAA"]->as<Rigidbody2d>()->applyForce(glm::vec2(0,-1));
+	control.addBind("push2", [&push](){
+		push.y -= 1;
 	}, GLFW_KEY_DOWN);
-	control.addBind("push3", [&test](){
-		test["AAA"]->as<Rigidbody2d>()->applyForce(glm::vec2(1,0));
+	control.addBind("push3", [&push](){
+		push.x += 1;
 	}, GLFW_KEY_RIGHT);
-	control.addBind("push4", [&test](){
-		test["AAA"]->as<Rigidbody2d>()->applyForce(glm::vec2(-1,0));
+	control.addBind("push4", [&push](){
+		push.x -= 1;
 	}, GLFW_KEY_LEFT);
 
 	////////////////////////////////////////////////
@@ -126,8 +142,19 @@ int main() {
 			imgui_input.undo_solo();
 		
 		glfwPollEvents();
+		player.clearControls();
+		push = glm::vec2(0);
 		Input::processActive(window);
 
+		simulation.advance(deltaTime, [&player, &a, &push](float tick) {
+			if(push != glm::vec2(0))
+				a.applyForce(push);
+			player.update(tick);
+			Rigidbody2d::updateAll(tick);
+			Collider::checkAll(tick);
+			ProjectilePool::updateAll(tick);
+		});
+
 		ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
 		ImGui::NewFrame();
@@ -145,9 +172,10 @@ int main() {
 			ImGui::Begin("Player");
 			ImGui::Text(("X: " + std::to_string(player.getPos().x)).c_str());
 			ImGui::Text(("Y: " + std::to_string(player.getPos().y)).c_str());
-			ImGui::Text(("VX: " + std::to_string(player.get<Rigidbody2d>("rigidbody").velocity.x)).c_str());
-			ImGui::Text(("VY: " + std::to_string(player.get<Rigidbody2d>("rigidbody").velocity.y)).c_str());
-			ImGui::Text(("AV: " + std::to_string(player.get<Rigidbody2d>("rigidbody").angular_velocity)).c_str());
+			ImGui::Text(("VX: " + std::to_string(player.rigidbody->getVelocity().x)).c_str());
+			ImGui::Text(("VY: " + std::to_string(player.rigidbody->getVelocity().y)).c_str());
+			ImGui::Text(("AV: " + std::to_string(player.rigidbody->getAngularVelocity())).c_str());
+			ImGui::Text(("Health: " + std::to_string(player.health)).c_str());
 			ImGui::SliderFloat("Mass", &player.ship_class.mass, 0.1, 50);
 			ImGui::SliderFloat("Power", &player.ship_class.thrust_power, 0, 10);
 			ImGui::End();
@@ -155,12 +183,29 @@ int main() {
 			ImGui::Begin("Rigidbody test");
 			ImGui::Text(("X: " + std::to_string(test.getPos().x)).c_str());
 			ImGui::Text(("Y: " + std::to_string(test.getPos().y)).c_str());
-			ImGui::Text(("VX: " + std::to_string(a.velocity.x)).c_str());
-			ImGui::Text(("VY: " + std::to_string(a.velocity.y)).c_str());
-			ImGui::Text(("AV: " + std::to_string(a.angular_velocity)).c_str());
+			ImGui::Text(("VX: " + std::to_string(a.getVelocity().x)).c_str());
+			ImGui::Text(("VY: " + std::to_string(a.getVelocity().y)).c_str());
+			ImGui::Text(("AV: " + std::to_string(a.getAngularVelocity())).c_str());
 			ImGui::Text(("FX: " + std::to_string(a.getNetForce().x)).c_str());
 			ImGui::Text(("FY: " + std::to_string(a.getNetForce().y)).c_str());
 			ImGui::End();
+
+			ImGui::Begin("Physics");
+			ImGui::Text(("Colliders: " + std::to_string(Collider::stats.colliders)).c_str());
+			ImGui::Text(("Pairs tested: " + std::to_string(Collider::stats.pairs_tested)).c_str());
+			ImGui::Text(("Pairs colliding: " + std::to_string(Collider::stats.pairs_colliding)).c_str());
+			ImGui::Text(("Pairs asleep: " + std::to_string(Collider::stats.pairs_sleeping)).c_str());
+			ImGui::Text(("Pairs filtered: " + std::to_string(Collider::stats.pairs_filtered)).c_str());
+			ImGui::Text(("Tree height: " + std::to_string(Collider::stats.tree_height)).c_str());
+			ImGui::Text(("Leaves moved: " + std::to_string(Collider::stats.proxies_moved)).c_str());
+			ImGui::Text(("Transforms changed: " + std::to_string(Collider::stats.transforms_changed)).c_str());
+			ImGui::Text(("GJK iterations: " + std::to_string(Collider::stats.gjk_iterations)).c_str());
+			ImGui::Text(("GJK early exits: " + std::to_string(Collider::stats.gjk_warm_exits)).c_str());
+			ImGui::Text(("EPA iterations: " + std::to_string(Collider::stats.epa_iterations)).c_str());
+			ImGui::Text(("Collision events: " + std::to_string(CollisionEvents::get().size())).c_str());
+			ImGui::Text(("Ticks dropped: " + std::to_string(simulation.getDroppedTicks())).c_str());
+			ImGui::Text(("Projectiles: " + std::to_string(bullets.size())).c_str());
+			ImGui::End();
 		}
 
 		player["chunk_loader"]->as<ChunkLoader>()->loadChunksSquare();
@@ -171,10 +216,6 @@ int main() {
 		// background.draw(bg);
 		Renderable::draw_all();
 
-		player.update(deltaTime);
-		Rigidbody2d::updateAll(deltaTime);
-		Collider::checkAll(deltaTime);
-
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 		glfwSwapBuffers(window);
@@ -185,6 +226,28 @@ int main() {
 	return 0;
 }
 
+// Ship classes, and the "layer_matrix" of collision layers that never touch
+bool loadGameConfig(std::string path) {
+	std::ifstream file(path);
+	Json::Value j;
+	try {
+		file >> j;
+	} catch(const Json::Exception&) {
+		log("Couldn't read the game config \"" + path + "\"", CRIT);
+		return false;
+	}
+
+	Collider::loadLayerMatrix(j["layer_matrix"]);
+	for(const Json::Value& ship_class : j["ship_classes"])
+		Ship::ship_classes.push_back(ShipClass::fromJson(ship_class));
+
+	if(Ship::ship_classes.empty()) {
+		log("The game config \"" + path + "\" has no ship classes", CRIT);
+		return false;
+	}
+	return true;
+}
+
 TileGrid gridTest() {
 	// tiles.insert(std::pair(1, glm::vec2(-1, 0)));
 	// tiles.insert(std::pair(1, glm::vec2(1,0)));
@@ -0,0 +1,112 @@
+#include "objAllocator.h"
+#include "logs.h"
+
+#include <string>
+
+static size_t roundUp(size_t size) {
+	const size_t alignment = alignof(std::max_align_t);
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+ObjAllocator* ObjAllocator::ownerOf(void* object) {
+	return (static_cast<Header*>(object) - 1)->owner;
+}
+
+void* ObjAllocator::stamp(void* block) {
+	Header* header = static_cast<Header*>(block);
+	header->owner = this;
+	live_count++;
+	return header + 1;
+}
+
+
+ObjPool::ObjPool(size_t object_size) : block_size(sizeof(Header) + roundUp(object_size)) {}
+
+void* ObjPool::allocate() {
+	if(!free_list) {
+		chunks.emplace_back(new unsigned char[block_size * chunk_blocks]);
+		unsigned char* chunk = chunks.back().get();
+		for(unsigned i = chunk_blocks; i-- > 0;) { // Backwards, so blocks come off the list in address order
+			void* block = chunk + i * block_size;
+			*static_cast<void**>(block) = free_list;
+			free_list = block;
+		}
+	}
+
+	void* block = free_list;
+	free_list = *static_cast<void**>(block);
+	return stamp(block);
+}
+
+void ObjPool::release(void* object) {
+	void* block = static_cast<Header*>(object) - 1;
+	*static_cast<void**>(block) = free_list;
+	free_list = block;
+	live_count--;
+}
+
+
+ObjArena::ObjArena(size_t chunk_size) : blocks(new Blocks(chunk_size)) {}
+
+ObjArena::~ObjArena() {
+	if(current_arena == this)
+		current_arena = nullptr;
+
+	// The objects that are left still point at their blocks, and there's no telling which those are
+	if(blocks->live()) {
+		log("Arena destroyed with " + std::to_string(blocks->live()) + " objects still alive, keeping its memory until they're gone", ERR);
+		blocks->orphaned = true;
+		return;
+	}
+	delete blocks;
+}
+
+void* ObjArena::allocate(size_t size) {
+	return blocks->allocate(size);
+}
+
+void ObjArena::reset() {
+	if(blocks->live()) {
+		log("Can't reset an arena with " + std::to_string(blocks->live()) + " objects still alive", ERR);
+		return;
+	}
+	blocks->reset();
+}
+
+void* ObjArena::Blocks::allocate(size_t size) {
+	size_t needed = sizeof(Header) + roundUp(size);
+	if(needed > chunk_size) { // Too big to share a chunk
+		large.emplace_back(new unsigned char[needed]);
+		return stamp(large.back().get());
+	}
+
+	if(chunks.empty() || used + needed > chunk_size) {
+		chunks.emplace_back(new unsigned char[chunk_size]);
+		used = 0;
+	}
+
+	void* block = chunks.back().get() + used;
+	used += needed;
+	return stamp(block);
+}
+
+void ObjArena::Blocks::release(void*) {
+	live_count--; // The memory waits for reset()
+	if(orphaned && live_count == 0)
+		delete this;
+}
+
+void ObjArena::Blocks::reset() {
+	if(chunks.size() > 1)
+		chunks.erase(chunks.begin() + 1, chunks.end());
+	large.clear();
+	used = 0;
+}
+
+ObjArena::Scope::Scope(ObjArena& arena) : previous(current_arena) {
+	current_arena = &arena;
+}
+
+ObjArena::Scope::~Scope() {
+	current_arena = previous;
+}
@@ -20,16 +20,20 @@ void Object::operator+=(Object::ptr &o) {
 	// o->parent-= o;
 
 	o->parent = this;
+	o->invalidateTransforms();
 	components.push_back(std::move(o));
+	componentsChanged();
 }
 
 // Moves several objects from one parent to another
 void Object::operator+=(std::vector<Object::ptr> &o_vec){
 	for(auto it = o_vec.begin(); it != o_vec.end(); it++){
 		(*it)->parent = this;
+		(*it)->invalidateTransforms();
 		components.push_back(std::move(*it));
 		o_vec.erase(it);
 	}
+	componentsChanged();
 }
 
 // Deletes an object from the parent's vector 
@@ -43,16 +47,62 @@ void Object::operator-=(Object::ptr& o) {
 
 	std::remove(vec->begin(), vec->end(), o);
 	o->parent = nullptr;
+	o->invalidateTransforms();
+	componentsChanged();
+}
+
+void Object::invalidateTransforms() {
+	for(auto& component : components)
+		component->invalidateTransforms();
 }
 
 // Returns a refrence to the specified element (a unique pointer)
-Object::ptr& Object::get(std::string id) {
-	auto index = std::find_if(components.begin(), components.end(), [id](const Object::ptr& o) -> bool { return o->id == id; });
-	if(index == components.end()) { // If the component could not be found, throw an exception
-		// log("\"" + this->id + "\" does not contain a \"" + id + "\"", WARN); // Log the faliure only the first time
-		throw ObjectMissingException(id, this->id);
+Object::ptr& Object::get(Symbol id) {
+	int index = componentIndex(id);
+	if(index != -1)
+		return components[index];
+	// log("\"" + this->id + "\" does not contain a \"" + id + "\"", WARN); // Log the faliure only the first time
+	throw ObjectMissingException(id, this->id);
+}
+
+Object* Object::find(Symbol id) {
+	int index = componentIndex(id);
+	return index == -1 ? nullptr : components[index].get();
+}
+
+int Object::componentIndex(Symbol id) {
+	if(indexed_version != components_version)
+		indexComponents();
+	if(component_slots.empty())
+		return -1;
+
+	uint32_t mask = component_slots.size() - 1;
+	for(uint32_t slot = id.value() * 2654435761u & mask; component_slots[slot]; slot = (slot + 1) & mask) {
+		unsigned index = component_slots[slot] - 1;
+		if(components[index]->id == id)
+			return index;
+	}
+	return -1;
+}
+
+// Twice as many slots as components, rounded up to a power of two, so probes stay short
+void Object::indexComponents() {
+	unsigned size = 4;
+	while(size < components.size() * 2)
+		size *= 2;
+	component_slots.assign(components.empty() ? 0 : size, 0);
+	indexed_version = components_version;
+
+	uint32_t mask = size - 1;
+	for(unsigned i = 0; i < components.size(); i++) {
+		if(!components[i])
+			continue; // Left behind by -=
+		uint32_t slot = components[i]->id.value() * 2654435761u & mask;
+		while(component_slots[slot] && components[component_slots[slot] - 1]->id != components[i]->id)
+			slot = (slot + 1) & mask;
+		if(!component_slots[slot])
+			component_slots[slot] = i + 1; // Duplicate ids keep the first one, like the old linear search
 	}
-	return *index; // Try dynamic_cast<unique<T>>& if breaks
 }
 
 // Same as above, but 
@@ -61,7 +111,7 @@ Object::ptr& Object::operator[](size_t index) {
 }
 
 // Equivalent to get(id)
-Object::ptr& Object::operator[](std::string id) { 
+Object::ptr& Object::operator[](Symbol id) { 
 	return get(id);
 }
 
@@ -70,8 +120,10 @@ void Object::createComponents(Json::Value items) {
 	for(unsigned i = 0; i < items.size(); i++) {
 		Object::ptr o = ObjFactory::createObjectJson(items[i]["type"].asString(), items[i]);
 		o->parent = this;
+		o->invalidateTransforms();
 		components.push_back(std::move(o));
 	}
+	componentsChanged();
 }
 
 Object::ptr ObjFactory::createObjectJson(std::string const& s, Json::Value json) {
@@ -83,9 +135,23 @@ Object::ptr ObjFactory::createObjectJson(std::string const& s, Json::Value json)
 	return it->second(json); // Create an object
 }
 
+uint16_t ObjFactory::newTypeIndex() {
+	static uint16_t count = 1; // 0 is Object
+	if(count == max_type_ids)
+		log("More than " + std::to_string(max_type_ids) + " object types have ids, the rest will use dynamic_cast", WARN);
+	return count++;
+}
+
 std::shared_ptr<ObjFactory::map_type> ObjFactory::getMap() {
 	if(!typemap) { typemap = std::make_shared<ObjFactory::map_type>(); } 
 	return typemap;
 }
 
 BlankObject::BlankObject(Json::Value j) : Object(j) {}
+
+void ObjectDeleter::operator()(Object* o) const {
+	void* memory = dynamic_cast<void*>(o); // Where the whole object starts, which isn't always where its Object part does
+	ObjAllocator* owner = ObjAllocator::ownerOf(memory);
+	o->~Object();
+	owner->release(memory);
+}
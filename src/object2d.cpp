@@ -1,7 +1,15 @@
 #include "object2d.h"
+#include "deterministicMath.h"
+
+TransformStore Object2d::transforms;
+float Object2d::tick_alpha = 1;
+unsigned Object2d::tick = 0;
+bool Object2d::ticking = false;
 
 Object2d::Object2d(std::string _id, glm::vec2 _pos, float _rot, glm::vec2 _scl) : 
-Object(_id), position(_pos), rotation(_rot), scale(_scl) {}
+Object(_id), position(_pos), rotation(_rot), scale(_scl), last_position(_pos), last_rotation(_rot), last_scale(_scl) {
+	transform_handle = transforms.add(this);
+}
 
 // Object2d::Object2d(Object2d* _parent, glm::vec2 _pos, float _rot, glm::vec2 _scl) : 
 // position(_pos), rotation(_rot), scale(_scl) {
@@ -10,6 +18,8 @@ Object(_id), position(_pos), rotation(_rot), scale(_scl) {}
 // }
 
 Object2d::Object2d(Json::Value j) : Object(j) {
+	transform_handle = transforms.add(this);
+
 	Json::Value jPos = j["pos"];
 	Json::Value jScl = j["scl"];
 	Json::ArrayIndex x=0, y=1; // Gee thanks implicit conversion of int to const char*, now we have to explicitly specify the type here
@@ -23,12 +33,22 @@ Object2d::Object2d(Json::Value j) : Object(j) {
 	scale.y = jScl.get(y, default_scl.y).asFloat();
 
 	obj_layer = j["obj_layer"].asInt();
+
+	last_position = position;
+	last_rotation = rotation;
+	last_scale = scale;
 }
 
-Object2d::~Object2d() {}
+Object2d::~Object2d() {
+	transforms.remove(transform_handle);
+}
 
 Object2d& Object2d::setPos(glm::vec2 pos) {
+	rememberLast();
 	position = pos;
+	if(!ticking)
+		last_position = pos;
+	transformSet();
 	return *this;
 }
 
@@ -39,7 +59,11 @@ Object2d& Object2d::setRot(float rot) {
 		rot = fmod(rot, 360);
 	}
 
+	rememberLast();
 	rotation = rot;
+	if(!ticking)
+		last_rotation = rot;
+	transformSet();
 	return *this;
 }
 
@@ -49,7 +73,11 @@ Object2d& Object2d::setScl(glm::vec2 scl) {
 	if(scl.y == 0)
 		scl.y = 1;
 
+	rememberLast();
 	scale = scl;
+	if(!ticking)
+		last_scale = scl;
+	transformSet();
 	return *this;
 }
 
@@ -118,54 +146,98 @@ float degreeFromMat4(glm::mat4 in) {
 	
 	// This should give us the counterclockwise angle of the object
 	// Theta = arccos((Tr(R) - 1) / 2)
-	return glm::degrees(acos(trace / 2));
+	return glm::degrees(dmath::acos(trace / 2));
 }
 
 glm::mat4 rotationMat4(float degree) {
+	float s, c;
+	dmath::sinCosDeg(degree, &s, &c);
+
 	glm::mat4 rot = glm::mat4(1);
-	rot[0][0] = cos(glm::radians(degree));
-	rot[1][1] = cos(glm::radians(degree));
-	rot[0][1] = sin(glm::radians(degree));
-	rot[1][0] = -sin(glm::radians(degree));
+	rot[0][0] = c;
+	rot[1][1] = c;
+	rot[0][1] = s;
+	rot[1][0] = -s;
 
 	return rot;
 }
 
 // Returns an objects local transformation matrix
 glm::mat4 Object2d::getTransform() const {
-	// Get matricies for each transformation
-	glm::mat4 translate_mat = glm::translate(glm::mat4(1), glm::vec3(getPos(), obj_layer));
-	glm::mat4 rotate_mat = glm::rotate(glm::mat4(1), glm::radians(getRot()), glm::vec3(0, 0, 1));//rotationMat4(getRot()); 
-	glm::mat4 scale_mat = glm::scale(glm::mat4(1), glm::vec3(getScl(), 1));
-
-	// Combine them all here
-	glm::mat4 transform = translate_mat * rotate_mat * scale_mat;
-
-	return transform;
+	return getAffine().toMat4();
 }
 
 // Applies parent transformation matricies if any
 glm::mat4 Object2d::getWorldTransform() const {
-	glm::mat4 transform = getTransform();
-
-	if(parent) {
-		// This function checks if a parent has a transform, and applies it if it does
-		std::function<void(Object*, glm::mat4&)> parentTransform = [](Object* _parent, glm::mat4& _transform) {
-			try { // Try to convert the parent to Object2d
-				Object2d* ptr_2d = _parent->as<Object2d>();
-				_transform = _transform * ptr_2d->getTransform(); // Apply the transformation if it worked
-			} catch(ObjectCastException &e) {
-				return; // If it failed, continue to the next parent
-			} 
-		};
-
-		// Now that the function is defined, run it for each parent in the hierarchy
-		parent->runup<glm::mat4&>(parentTransform, transform);
-		// The reason we use runup instead of regular recursion is that in the case
-		// one of the parents in the path upwards isn't Object2d, the recursion would stop
+	return getWorldAffine().toMat4();
+}
+
+Affine2d Object2d::getAffine() const {
+	unsigned i = transforms.index(transform_handle);
+	if(transforms.local_dirty[i]) {
+		transforms.local.set(i, composeTransform(position, rotation, scale));
+		transforms.local_dirty[i] = 0;
+	}
+	return transforms.local.get(i);
+}
+
+// Usually already done by updateTransforms(), otherwise works its way up to the first clean ancestor
+Affine2d Object2d::getWorldAffine() const {
+	unsigned i = transforms.index(transform_handle);
+	if(transforms.world_dirty[i]) {
+		Object2d* parent_2d = transforms.inOrder() ? transforms.parentOf(i) : parent2d();
+		transforms.world.set(i, parent_2d ? parent_2d->getWorldAffine() * getAffine() : getAffine());
+		transforms.world_dirty[i] = 0;
 	}
+	return transforms.world.get(i);
+}
+
+void Object2d::updateTransforms() {
+	transforms.update();
+}
+
+void Object2d::updateRenderTransforms() {
+	transforms.updateRender(tick_alpha);
+}
+
+const TransformStore& Object2d::getTransforms() {
+	return transforms;
+}
+
+unsigned Object2d::getTransformIndex() const {
+	return transforms.index(transform_handle);
+}
+
+void Object2d::transformSet() {
+	transforms.local_dirty[transforms.index(transform_handle)] = 1;
+	invalidateWorld();
+}
+
+void Object2d::invalidateTransforms() {
+	// Also called when this or an ancestor changes parents, the store has to be sorted again if that moved this one
+	if(transforms.inOrder() && parent2d() != transforms.parentOf(transforms.index(transform_handle)))
+		transforms.hierarchyChanged();
+	invalidateWorld();
+}
+
+void Object2d::invalidateWorld() {
+	unsigned i = transforms.index(transform_handle);
+	if(transforms.world_dirty[i])
+		return; // Everything below is already dirty
+	transforms.invalidate(i);
+	Object::invalidateTransforms();
+}
+
+Object2d* Object2d::parent2d() const {
+	for(Object* p = parent; p; p = p->parent) {
+		if(Object2d* p_2d = p->tryAs<Object2d>())
+			return p_2d;
+	}
+	return nullptr;
+}
 
-	return transform;
+Affine2d Object2d::composeTransform(glm::vec2 pos, float rot, glm::vec2 scl) const {
+	return Affine2d::compose(pos, rot, scl, obj_layer);
 }
 
 Object2d& Object2d::setTransform(glm::mat4 in) {
@@ -193,17 +265,98 @@ Object2d& Object2d::transformBy(glm::mat4 in) {
 	return *this;
 }
 
+glm::vec2 Object2d::getRenderPos() const {
+	if(!prevent_inherit_pos)
+		return glm::vec2(getRenderTransform()[3]);
+	else
+		return getBlendedPos();
+}
+
+float Object2d::getRenderRot() const {
+	if(!prevent_inherit_rot)
+		return degreeFromMat4(getRenderTransform());
+	else
+		return getBlendedRot();
+}
+
+glm::mat4 Object2d::getRenderTransform() const {
+	return getRenderAffine().toMat4();
+}
+
+// Read from the store if updateRenderTransforms() ran since anything last moved, worked out here otherwise
+Affine2d Object2d::getRenderAffine() const {
+	if(transforms.renderCurrent(tick_alpha))
+		return transforms.render.get(transforms.index(transform_handle));
+
+	Object2d* parent_2d = parent2d();
+	return parent_2d ? parent_2d->getRenderAffine() * getBlendedAffine() : getBlendedAffine();
+}
+
+void Object2d::beginTick() {
+	tick++;
+	ticking = true;
+	transforms.stopBlending();
+}
+
+void Object2d::endTick() {
+	ticking = false;
+}
+
+void Object2d::rememberLast() {
+	if(!ticking || last_tick == tick)
+		return;
+
+	last_position = position;
+	last_rotation = rotation;
+	last_scale = scale;
+	last_tick = tick;
+	transforms.blend(transforms.index(transform_handle));
+}
+
+// Only objects that changed during the latest tick have anything to blend from
+
+glm::vec2 Object2d::getBlendedPos() const {
+	if(last_tick != tick)
+		return position;
+	return glm::mix(last_position, position, tick_alpha);
+}
+
+float Object2d::getBlendedRot() const {
+	if(last_tick != tick)
+		return rotation;
+
+	// Take the short way around
+	float difference = fmod(rotation - last_rotation, 360.f);
+	if(difference > 180)
+		difference -= 360;
+	else if(difference < -180)
+		difference += 360;
+	return last_rotation + difference * tick_alpha;
+}
+
+glm::vec2 Object2d::getBlendedScl() const {
+	if(last_tick != tick)
+		return scale;
+	return glm::mix(last_scale, scale, tick_alpha);
+}
+
+Affine2d Object2d::getBlendedAffine() const {
+	if(last_tick != tick)
+		return getAffine();
+	return composeTransform(getBlendedPos(), getBlendedRot(), getBlendedScl());
+}
+
 
 glm::vec2 Object2d::up() {
 	return glm::vec2(
-		cos(glm::radians(rotation + 90.f)), 
-		sin(glm::radians(rotation + 90.f))
+		dmath::cosDeg(rotation + 90.f), 
+		dmath::sinDeg(rotation + 90.f)
 	);
 }
 
 glm::vec2 Object2d::right() {
 	return glm::vec2(
-		cos(glm::radians(rotation)), 
-		sin(glm::radians(rotation))
+		dmath::cosDeg(rotation), 
+		dmath::sinDeg(rotation)
 	);
 }
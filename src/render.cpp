@@ -32,6 +32,8 @@ Shader* Renderable::register_shader(Shader* shader) {
 void Renderable::draw(Shader& shader) {}
 
 void Renderable::draw_all() {
+	Object2d::updateRenderTransforms();
+
 	// for(Camera2d* cam : cameras) {
 		for(auto& shader : Renderable::shaders) {
 			shader->set("view", Camera2d::main_camera->getViewMatrix());
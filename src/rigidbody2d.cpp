@@ -1,106 +1,305 @@
 #include "rigidbody2d.h"
+#include "deterministicMath.h"
+
+float Rigidbody2d::sweep_contact_depth = 0.01f;
+float Rigidbody2d::default_radius = 0.5f;
+bool Rigidbody2d::sleeping_enabled = true;
+float Rigidbody2d::sleep_velocity = 0.05f;
+float Rigidbody2d::sleep_angular_velocity = 2.f;
+float Rigidbody2d::sleep_delay = 0.5f;
+BodyStore Rigidbody2d::bodies;
+std::vector<unsigned> Rigidbody2d::islands;
+std::vector<float> Rigidbody2d::island_sleep_time;
+std::vector<Rigidbody2d*> Rigidbody2d::island_changes;
 
 Rigidbody2d::Rigidbody2d(std::string id, std::vector<glm::vec2> mesh, float mass) : Object(id) {
-	this->collider = std::make_unique<MeshCollider>("collider", mesh);
-	collider->parent = this;
+	handle = bodies.add(this);
+	this->collider = makeObj<MeshCollider>("collider", mesh);
+	this->collider->parent = this;
+	this->collider->body = this;
 	setMass(mass);
-	bodies.push_back(this);
 }
 
-Rigidbody2d::Rigidbody2d(std::string id, std::unique_ptr<Collider> collider, float mass) : Object(id) {
+Rigidbody2d::Rigidbody2d(std::string id, ObjPtr<Collider> collider, float mass) : Object(id) {
+	handle = bodies.add(this);
 	this->collider = std::move(collider);
-	collider->parent = this;
+	this->collider->parent = this;
+	this->collider->body = this;
 	setMass(mass);
-	bodies.push_back(this);
+}
+
+Rigidbody2d::Rigidbody2d(Json::Value j) : Object(j) {
+	handle = bodies.add(this);
+	std::vector<glm::vec2> points;
+	for(const Json::Value& point : j["points"])
+		points.emplace_back(point[0].asFloat(), point[1].asFloat());
+
+	if(j.isMember("radius")) {
+		this->collider = makeObj<CircleCollider>("collider", j["radius"].asFloat());
+	} else if(points.size() >= 3) {
+		this->collider = makeObj<MeshCollider>("collider", points);
+	} else {
+		// A hull with fewer than 3 points has no support points for the narrowphase to find
+		log("Rigidbody \"" + id.str() + "\" needs a radius or at least 3 points, using a circle instead", ERR);
+		this->collider = makeObj<CircleCollider>("collider", default_radius);
+	}
+	this->collider->parent = this;
+	this->collider->body = this;
+	this->collider->loadFilter(j["collision"]);
+	setMass(j.get("mass", 1).asFloat());
+	setFast(j.get("fast", false).asBool());
 }
 
 Rigidbody2d::~Rigidbody2d() {
-	bodies.erase(std::find(bodies.begin(), bodies.end(), this));
+	bodies.remove(handle);
+}
+
+const BodyStore& Rigidbody2d::getStore() {
+	return bodies;
 }
 
 float Rigidbody2d::getMass() const {
 	return mass;
 }
 
+float Rigidbody2d::getInverseMass() const {
+	return bodies.inv_mass[bodies.index(handle)];
+}
+
+float Rigidbody2d::getInverseInertia() const {
+	return bodies.inv_moi[bodies.index(handle)];
+}
+
 glm::vec2 Rigidbody2d::getNetForce() const {
-	return net_force;
+	unsigned i = bodies.index(handle);
+	return glm::vec2(bodies.force_x[i], bodies.force_y[i]);
+}
+
+glm::vec2 Rigidbody2d::getVelocity() const {
+	unsigned i = bodies.index(handle);
+	return glm::vec2(bodies.vel_x[i], bodies.vel_y[i]);
+}
+
+float Rigidbody2d::getAngularVelocity() const {
+	return bodies.ang_vel[bodies.index(handle)];
+}
+
+bool Rigidbody2d::isFast() const {
+	return bodies.fast[bodies.index(handle)];
+}
+
+BodyStore::Handle Rigidbody2d::getHandle() const {
+	return handle;
 }
 
 float Rigidbody2d::setMass(float mass) {
 	this->mass = mass;
 	collider->calcAttribs(mass);
+
+	unsigned i = bodies.index(handle);
+	bodies.inv_mass[i] = mass > 0 ? 1 / mass : 0;
+	bodies.inv_moi[i] = collider->moi > 0 ? 1 / collider->moi : 0;
 	return mass;
 }
 
+void Rigidbody2d::setVelocity(glm::vec2 velocity) {
+	if(velocity != glm::vec2(0))
+		wake();
+	unsigned i = bodies.index(handle);
+	bodies.vel_x[i] = velocity.x;
+	bodies.vel_y[i] = velocity.y;
+}
+
+void Rigidbody2d::setAngularVelocity(float angular_velocity) {
+	if(angular_velocity != 0)
+		wake();
+	bodies.ang_vel[bodies.index(handle)] = angular_velocity;
+}
+
+void Rigidbody2d::setFast(bool fast) {
+	bodies.fast[bodies.index(handle)] = fast;
+}
+
+void Rigidbody2d::invalidateTransforms() {
+	Object::invalidateTransforms();
+	if(collider)
+		collider->invalidateTransforms();
+}
+
+Object2d* Rigidbody2d::getTarget() {
+	if(parent != target_parent) {
+		target_parent = parent;
+		target = parent ? parent->tryAs<Object2d>() : nullptr;
+		if(target) {
+			unsigned i = bodies.index(handle);
+			bodies.pos_x[i] = target->getPos().x;
+			bodies.pos_y[i] = target->getPos().y;
+			bodies.rot[i] = target->getRot();
+		}
+	}
+	return target;
+}
+
 void Rigidbody2d::teleport_w(glm::vec2 position) {
-	try{
-		Object2d* p = parent->as<Object2d>();
+	wake();
+	if(Object2d* p = getTarget())
 		p->setWorldPos(position);
-	} catch(ObjectCastException&) {}
 }
 
 void Rigidbody2d::displace_w(glm::vec2 offset) {
-	try{
-		Object2d* p = parent->as<Object2d>();
+	wake();
+	if(Object2d* p = getTarget())
 		p->setWorldPos(p->getWorldPos() + offset);
-	} catch(ObjectCastException&) {}
 }
 
 void Rigidbody2d::displace(glm::vec2 offset) {
-	try{
-		Object2d* p = parent->as<Object2d>();
+	wake();
+	if(Object2d* p = getTarget())
 		p->setPos(p->getPos() + offset);
-	} catch(ObjectCastException&) {}
 }
 
 void Rigidbody2d::applyForce(glm::vec2 force, glm::vec2 pos) {
+	if(force == glm::vec2(0))
+		return;
+	wake();
+
 	float angle = 0;
 	if(pos != glm::vec2(0))
-		angle = glm::radians(glm::angle(glm::normalize(force), glm::normalize(pos)));
-	net_torque += glm::distance(glm::vec2(0), force) * glm::distance(glm::vec2(0), pos) * (float)sin(angle);
-	net_force += force * (float)cos(angle);
+		angle = glm::radians(dmath::acos(glm::clamp(glm::dot(glm::normalize(force), glm::normalize(pos)), -1.f, 1.f)));
+
+	float sin_angle, cos_angle;
+	dmath::sinCos(angle, &sin_angle, &cos_angle);
+
+	unsigned i = bodies.index(handle);
+	glm::vec2 linear = force * cos_angle;
+	bodies.torque[i] += glm::distance(glm::vec2(0), force) * glm::distance(glm::vec2(0), pos) * sin_angle;
+	bodies.force_x[i] += linear.x;
+	bodies.force_y[i] += linear.y;
 }
 
 void Rigidbody2d::applyTorque(float torque) {
-	net_torque += torque;
-}
-
-// no way this works
-void Rigidbody2d::collide(glm::vec2 resolution_vec, Rigidbody2d* b1, Rigidbody2d* b2, float deltaTime, float elastic) {
-	float total_mass = b1->mass + b2->mass;
-	glm::vec2 wtf = 2.f * b1->mass * b2->mass * (b2->velocity - b1->velocity) / total_mass; // divide by deltaTime??
-	// glm::vec2 this_accel((velocity / 2.f) * (elastic ? -1.f : 1.f));
-	b1->applyForce(wtf, resolution_vec);
-	b2->applyForce(-wtf, -resolution_vec);
-}
-
-void Rigidbody2d::update(float deltaTime) {
-	velocity += net_force / mass * deltaTime;
-	angular_velocity += net_torque / collider->moi * deltaTime;
-
-	// As of writing this, abs(float) decided to stop working so now we use fabs(), which is fine just weird
-	if(fabs(velocity.x) < 0.01)
-		velocity.x = 0;
-	if(fabs(velocity.y) < 0.01)
-		velocity.y = 0;
-	if(fabs(angular_velocity) < 0.1)
-		angular_velocity = 0;
-	
-	try{
-		Object2d* p = parent->as<Object2d>();
-		p->setPos(p->getPos() + velocity * deltaTime);
-		p->setRot(p->getRot() + angular_velocity * deltaTime); // Needs to be rotated around collider->center but that requires a rework
-	} catch(ObjectCastException&) {
-		// Set an error state or something, as this rigidbody doesn't have an object to update
-	}
+	if(torque == 0)
+		return;
+	wake();
+	bodies.torque[bodies.index(handle)] += torque;
+}
+
+void Rigidbody2d::applyImpulse(glm::vec2 impulse, glm::vec2 point) {
+	if(impulse == glm::vec2(0))
+		return;
+	wake();
+
+	unsigned i = bodies.index(handle);
+	glm::vec2 r = point - collider->getWorldCenter();
+	bodies.vel_x[i] += impulse.x * bodies.inv_mass[i];
+	bodies.vel_y[i] += impulse.y * bodies.inv_mass[i];
+	bodies.ang_vel[i] += glm::degrees((r.x * impulse.y - r.y * impulse.x) * bodies.inv_moi[i]);
+}
+
+bool Rigidbody2d::isAwake() const {
+	return bodies.isAwake(handle);
+}
+
+void Rigidbody2d::wake() {
+	if(bodies.isAwake(handle))
+		return;
+
+	bodies.setAwake(handle, true);
+	bodies.sleep_time[bodies.index(handle)] = 0;
+}
+
+void Rigidbody2d::sleep() {
+	bodies.setAwake(handle, false);
+	unsigned i = bodies.index(handle);
+	bodies.vel_x[i] = bodies.vel_y[i] = bodies.ang_vel[i] = 0;
+	bodies.force_x[i] = bodies.force_y[i] = bodies.torque[i] = 0;
+	collider->updateProxy(); // Sleeping colliders are skipped when the tree updates, so catch up on this step's movement now
+}
+
+void Rigidbody2d::sweepStep(unsigned index) {
+	// Stop just inside whatever is hit first instead of passing through it
+	glm::vec2 translation(bodies.step_x[index], bodies.step_y[index]);
+	float toi;
+	if(translation == glm::vec2(0) || !Collider::sweep(*collider, translation, &toi))
+		return;
+
+	float distance = glm::length(translation);
+	glm::vec2 cut = translation * (1 - std::min(toi + sweep_contact_depth / distance, 1.f));
+	bodies.step_x[index] -= cut.x;
+	bodies.step_y[index] -= cut.y;
+	bodies.pos_x[index] -= cut.x;
+	bodies.pos_y[index] -= cut.y;
+}
+
+void Rigidbody2d::moveTarget(unsigned index) {
+	Object2d* p = getTarget();
+	if(!p)
+		return; // Nothing to move, the body just drifts along in the store
+
+	p->setPos(p->getPos() + glm::vec2(bodies.step_x[index], bodies.step_y[index]));
+	p->setRot(p->getRot() + bodies.step_rot[index]); // Needs to be rotated around collider->center but that requires a rework
 
-	// Reset net forces
-	net_force = glm::vec2(0);
-	net_torque = 0;
+	// The object may have been moved by something else since the last step
+	bodies.pos_x[index] = p->getPos().x;
+	bodies.pos_y[index] = p->getPos().y;
+	bodies.rot[index] = p->getRot();
 }
 
 void Rigidbody2d::updateAll(float deltaTime) {
-	for(auto body : bodies) {
-		body->update(deltaTime);
+	bodies.integrate(deltaTime, sleep_velocity, sleep_angular_velocity);
+
+	// Only bodies that actually moved need to touch their objects, and sleeping ones never do
+	for(unsigned i = 0; i < bodies.awakeCount(); i++) {
+		if(bodies.step_x[i] == 0 && bodies.step_y[i] == 0 && bodies.step_rot[i] == 0)
+			continue;
+
+		Rigidbody2d* body = bodies.owners[i];
+		if(bodies.fast[i])
+			body->sweepStep(i);
+		body->moveTarget(i);
+	}
+}
+
+unsigned Rigidbody2d::findIsland(unsigned index) {
+	while(islands[index] != index) {
+		unsigned parent = islands[index];
+		islands[index] = islands[parent]; // Path halving, keeps the trees flat
+		index = parent;
+	}
+	return index;
+}
+
+void Rigidbody2d::updateIslands(const std::vector<std::pair<Rigidbody2d*, Rigidbody2d*>>& contacts) {
+	islands.resize(bodies.size());
+	for(unsigned i = 0; i < bodies.size(); i++)
+		islands[i] = i;
+
+	for(auto& contact : contacts) {
+		unsigned a = findIsland(bodies.index(contact.first->handle));
+		unsigned b = findIsland(bodies.index(contact.second->handle));
+		if(a != b)
+			islands[std::max(a, b)] = std::min(a, b);
+	}
+
+	// An island can only sleep if every body in it is ready to, sleeping bodies are always ready
+	island_sleep_time.assign(bodies.size(), std::numeric_limits<float>::max());
+	for(unsigned i = 0; i < bodies.awakeCount(); i++) {
+		float& time = island_sleep_time[findIsland(i)];
+		time = std::min(time, bodies.sleep_time[i]);
+	}
+
+	// Find everything that changes first, sleeping and waking move bodies around in the store
+	island_changes.clear();
+	for(unsigned i = 0; i < bodies.size(); i++) {
+		bool island_ready = sleeping_enabled && island_sleep_time[findIsland(i)] >= sleep_delay;
+		if(island_ready == (i < bodies.awakeCount()))
+			island_changes.push_back(bodies.owners[i]);
+	}
+
+	for(Rigidbody2d* body : island_changes) {
+		if(body->isAwake())
+			body->sleep();
+		else
+			body->wake();
 	}
-}
\ No newline at end of file
+}
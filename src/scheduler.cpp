@@ -0,0 +1,44 @@
+#include "scheduler.h"
+#include "object2d.h"
+
+#include <cmath>
+
+Scheduler::Scheduler(float tick_rate, unsigned max_ticks) : tick_length(1 / tick_rate), max_ticks(max_ticks) {}
+
+unsigned Scheduler::advance(float frame_time, std::function<void(float)> tick) {
+	accumulator += frame_time;
+
+	unsigned ran = 0;
+	while(accumulator >= tick_length) {
+		if(ran == max_ticks) {
+			// Give up on catching up, keep only the partial tick so blending still lines up
+			float behind = std::floor(accumulator / tick_length);
+			dropped_ticks += behind;
+			accumulator -= behind * tick_length;
+			break;
+		}
+
+		Object2d::beginTick();
+		tick(tick_length);
+		Object2d::endTick();
+
+		accumulator -= tick_length;
+		tick_count++;
+		ran++;
+	}
+
+	Object2d::tick_alpha = getAlpha();
+	return ran;
+}
+
+float Scheduler::getAlpha() const {
+	return accumulator / tick_length;
+}
+
+unsigned Scheduler::getTickCount() const {
+	return tick_count;
+}
+
+unsigned Scheduler::getDroppedTicks() const {
+	return dropped_ticks;
+}
@@ -83,7 +83,7 @@ void Sprite::draw(Shader& shader){
 	shader.set("sprite", (int)tex_unit);
 
 	obj_layer = getLayer();
-	shader.set("transform", getWorldTransform());
+	shader.set("transform", getRenderTransform());
 	shader.set("layer", getLayer());
 
 	// draw mesh
@@ -158,7 +158,7 @@ void TiledSprite::draw(Shader& shader) {
 	shader.set("sprite", (int)tex_unit);
 
 	obj_layer = getLayer();
-	shader.set("transform", getWorldTransform());
+	shader.set("transform", getRenderTransform());
 	shader.set("layer", getLayer());
 
 	int tile_count = tiling_range.x * tiling_range.y;
@@ -0,0 +1,31 @@
+#include "symbol.h"
+
+#include <deque>
+#include <unordered_map>
+
+// Deques never move what they hold, so the table's keys can point straight into it
+static std::deque<std::string>& names() {
+	static std::deque<std::string> names = { "" };
+	return names;
+}
+
+static std::unordered_map<std::string_view, uint32_t>& table() {
+	static std::unordered_map<std::string_view, uint32_t> table = { { names()[0], 0 } };
+	return table;
+}
+
+Symbol::Symbol(std::string_view s) {
+	auto it = table().find(s);
+	if(it != table().end()) {
+		index = it->second;
+		return;
+	}
+
+	index = names().size();
+	names().emplace_back(s);
+	table().emplace(names().back(), index);
+}
+
+const std::string& Symbol::str() const {
+	return names()[index];
+}
@@ -0,0 +1,235 @@
+#include "transformStore.h"
+#include "object2d.h"
+#include "deterministicMath.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <numeric>
+
+Affine2d Affine2d::compose(glm::vec2 pos, float rot, glm::vec2 scl, float z) {
+	float s, c;
+	dmath::sinCosDeg(rot, &s, &c);
+
+	Affine2d out;
+	out.a = c * scl.x;
+	out.b = s * scl.x;
+	out.c = -s * scl.y;
+	out.d = c * scl.y;
+	out.tx = pos.x;
+	out.ty = pos.y;
+	out.z = z;
+	return out;
+}
+
+TransformStore::Handle TransformStore::add(Object2d* owner) {
+	Handle handle;
+	if(free_handles.empty()) {
+		handle = handle_to_index.size();
+		handle_to_index.push_back(0);
+	} else {
+		handle = free_handles.back();
+		free_handles.pop_back();
+	}
+
+	handle_to_index[handle] = owners.size();
+	index_to_handle.push_back(handle);
+	owners.push_back(owner);
+	parent.push_back(-1);
+	local_dirty.push_back(1);
+	world_dirty.push_back(1);
+	blending.push_back(0);
+	forEachArray([](std::vector<float>& array) {
+		array.push_back(0);
+	});
+
+	hierarchyChanged();
+	return handle;
+}
+
+// Moves the last entry into the removed one's place. That breaks the order, so it gets sorted again before the next pass
+void TransformStore::remove(Handle handle) {
+	unsigned index = handle_to_index[handle];
+	unsigned last = owners.size() - 1;
+
+	if(index != last) {
+		Handle moved = index_to_handle[last];
+		handle_to_index[moved] = index;
+		index_to_handle[index] = moved;
+
+		owners[index] = owners[last];
+		local_dirty[index] = local_dirty[last];
+		world_dirty[index] = world_dirty[last];
+		blending[index] = blending[last];
+		forEachArray([index, last](std::vector<float>& array) {
+			array[index] = array[last];
+		});
+	}
+
+	index_to_handle.pop_back();
+	owners.pop_back();
+	parent.pop_back();
+	local_dirty.pop_back();
+	world_dirty.pop_back();
+	blending.pop_back();
+	forEachArray([](std::vector<float>& array) {
+		array.pop_back();
+	});
+
+	free_handles.push_back(handle);
+	hierarchyChanged();
+}
+
+template<typename F>
+void TransformStore::forEachArray(F func) {
+	for(Affines* affines : { &local, &world, &render }) {
+		for(std::vector<float>* array : { &affines->a, &affines->b, &affines->c, &affines->d, &affines->tx, &affines->ty, &affines->z })
+			func(*array);
+	}
+}
+
+void TransformStore::stopBlending() {
+	std::fill(blending.begin(), blending.end(), 0);
+	render_valid = false;
+}
+
+// Orders everything by depth. Ties keep their handle order, so the same hierarchy always sorts the same way
+void TransformStore::sort() {
+	unsigned count = size();
+
+	std::vector<int> parent_of(count);
+	for(unsigned i = 0; i < count; i++) {
+		Object2d* p = owners[i]->parent2d();
+		parent_of[i] = p ? (int)index(p->transform_handle) : -1;
+	}
+
+	std::vector<unsigned> depth(count, 0);
+	std::vector<uint8_t> known(count, 0);
+	std::vector<unsigned> chain;
+	for(unsigned i = 0; i < count; i++) {
+		// Walk up until something with a known depth, then fill in the way back down
+		int at = i;
+		while(at != -1 && !known[at]) {
+			chain.push_back(at);
+			at = parent_of[at];
+		}
+		unsigned d = at == -1 ? 0 : depth[at] + 1;
+		for(auto it = chain.rbegin(); it != chain.rend(); it++) {
+			depth[*it] = d++;
+			known[*it] = 1;
+		}
+		chain.clear();
+	}
+
+	std::vector<unsigned> order(count);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](unsigned x, unsigned y) {
+		return depth[x] != depth[y] ? depth[x] < depth[y] : index_to_handle[x] < index_to_handle[y];
+	});
+
+	std::vector<unsigned> new_index(count);
+	for(unsigned i = 0; i < count; i++)
+		new_index[order[i]] = i;
+
+	auto permute = [&order](auto& array) {
+		auto old = array;
+		for(unsigned i = 0; i < order.size(); i++)
+			array[i] = old[order[i]];
+	};
+	forEachArray(permute);
+	permute(owners);
+	permute(index_to_handle);
+	permute(local_dirty);
+	permute(world_dirty);
+	permute(blending);
+
+	levels.clear();
+	for(unsigned i = 0; i < count; i++) {
+		unsigned old = order[i];
+		parent[i] = parent_of[old] == -1 ? -1 : (int)new_index[parent_of[old]];
+		handle_to_index[index_to_handle[i]] = i;
+		if(i == 0 || depth[old] != depth[order[i - 1]])
+			levels.push_back(i);
+	}
+	levels.push_back(count);
+
+	order_dirty = false;
+	world_changed = true; // Parents may have changed without anything being marked
+}
+
+void TransformStore::update() {
+	if(order_dirty)
+		sort();
+	if(!world_changed)
+		return;
+
+	for(unsigned i = 0; i < size(); i++) {
+		if(local_dirty[i])
+			owners[i]->getAffine(); // Fills in local[i]
+	}
+
+	propagate(local, world);
+	std::fill(world_dirty.begin(), world_dirty.end(), 0);
+	world_changed = false;
+}
+
+void TransformStore::updateRender(float alpha) {
+	update();
+
+	if(std::find(blending.begin(), blending.end(), 1) == blending.end()) {
+		render = world; // Nothing's between ticks
+	} else {
+		render_local = local;
+		for(unsigned i = 0; i < size(); i++) {
+			if(blending[i])
+				render_local.set(i, owners[i]->getBlendedAffine());
+		}
+		propagate(render_local, render);
+	}
+
+	render_valid = true;
+	render_alpha = alpha;
+}
+
+void TransformStore::propagate(const Affines& locals, Affines& out) {
+	if(levels.empty())
+		return;
+
+	// Roots have nothing to multiply by
+	for(std::vector<float> Affines::* field : { &Affines::a, &Affines::b, &Affines::c, &Affines::d, &Affines::tx, &Affines::ty, &Affines::z })
+		std::copy((locals.*field).begin(), (locals.*field).begin() + levels[1], (out.*field).begin());
+
+	for(unsigned level = 1; level + 1 < levels.size(); level++) {
+		unsigned i = levels[level];
+		unsigned end = levels[level + 1];
+
+#if defined(__AVX__) || defined(__SSE2__)
+		// Parents are scattered through the earlier levels, so gather them into a register's worth first
+		float pa[simd::width], pb[simd::width], pc[simd::width], pd[simd::width], ptx[simd::width], pty[simd::width], pz[simd::width];
+		for(; i + simd::width <= end; i += simd::width) {
+			for(unsigned k = 0; k < simd::width; k++) {
+				int p = parent[i + k];
+				pa[k] = out.a[p]; pb[k] = out.b[p]; pc[k] = out.c[p]; pd[k] = out.d[p];
+				ptx[k] = out.tx[p]; pty[k] = out.ty[p]; pz[k] = out.z[p];
+			}
+
+			simd::floats a = simd::load(pa), b = simd::load(pb), c = simd::load(pc), d = simd::load(pd);
+			simd::floats la = simd::load(&locals.a[i]), lb = simd::load(&locals.b[i]);
+			simd::floats lc = simd::load(&locals.c[i]), ld = simd::load(&locals.d[i]);
+			simd::floats ltx = simd::load(&locals.tx[i]), lty = simd::load(&locals.ty[i]);
+
+			// The same operations in the same order as Affine2d::operator*, so both give the same bits
+			simd::store(&out.a[i], simd::add(simd::mul(a, la), simd::mul(c, lb)));
+			simd::store(&out.b[i], simd::add(simd::mul(b, la), simd::mul(d, lb)));
+			simd::store(&out.c[i], simd::add(simd::mul(a, lc), simd::mul(c, ld)));
+			simd::store(&out.d[i], simd::add(simd::mul(b, lc), simd::mul(d, ld)));
+			simd::store(&out.tx[i], simd::add(simd::add(simd::mul(a, ltx), simd::mul(c, lty)), simd::load(ptx)));
+			simd::store(&out.ty[i], simd::add(simd::add(simd::mul(b, ltx), simd::mul(d, lty)), simd::load(pty)));
+			simd::store(&out.z[i], simd::add(simd::load(&locals.z[i]), simd::load(pz)));
+		}
+#endif
+
+		// Whatever didn't fill a whole register
+		for(; i < end; i++)
+			out.set(i, out.get(parent[i]) * locals.get(i));
+	}
+}
@@ -0,0 +1,105 @@
+#include "workerPool.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned thread_count) : thread_count(thread_count) {}
+
+WorkerPool::~WorkerPool() {
+	stopThreads();
+}
+
+void WorkerPool::setThreadCount(unsigned thread_count) {
+	stopThreads();
+	this->thread_count = thread_count;
+	started = false; // The new threads start with the next job
+}
+
+void WorkerPool::startThreads(unsigned thread_count) {
+	stopping = false;
+	for(unsigned i = 0; i < thread_count; i++)
+		threads.emplace_back(&WorkerPool::threadMain, this, i + 1, generation); // Worker 0 is the calling thread
+}
+
+void WorkerPool::stopThreads() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	work_ready.notify_all();
+
+	for(auto& thread : threads)
+		thread.join();
+	threads.clear();
+}
+
+void WorkerPool::parallelFor(unsigned count, unsigned batch_size, std::function<void(unsigned, unsigned, unsigned)> task) {
+	if(count == 0)
+		return;
+
+	if(!started) {
+		started = true;
+		startThreads(thread_count);
+	}
+
+	// Not worth waking anyone up for
+	if(threads.empty() || count <= batch_size) {
+		task(0, count, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task = std::move(task);
+		this->count = count;
+		this->batch_size = std::max(batch_size, 1u);
+		next_batch = 0;
+		busy = threads.size();
+		generation++;
+	}
+	work_ready.notify_all();
+
+	runBatches(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	work_done.wait(lock, [this]() { return busy == 0; });
+	this->task = nullptr;
+}
+
+unsigned WorkerPool::getWorkerCount() const {
+	return thread_count + 1;
+}
+
+unsigned WorkerPool::defaultThreadCount() {
+	unsigned cores = std::thread::hardware_concurrency();
+	return cores > 1 ? cores - 1 : 0;
+}
+
+// seen is the last job this thread knows about, it waits for the next one
+void WorkerPool::threadMain(unsigned worker, unsigned seen) {
+	while(true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			work_ready.wait(lock, [this, seen]() { return stopping || generation != seen; });
+			if(stopping)
+				return;
+			seen = generation;
+		}
+
+		runBatches(worker);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busy--;
+		}
+		work_done.notify_one();
+	}
+}
+
+void WorkerPool::runBatches(unsigned worker) {
+	while(true) {
+		unsigned begin = next_batch.fetch_add(batch_size);
+		if(begin >= count)
+			return;
+		task(begin, std::min(begin + batch_size, count), worker);
+	}
+}
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec2 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec4 aInstance; // Position, then the direction the projectile faces
+
+out vec3 FragPos;
+out vec2 TexCoord;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform int layer;
+
+void main() {
+    vec2 facing = aInstance.zw;
+    vec2 right = vec2(facing.y, -facing.x);
+    FragPos = vec3(aInstance.xy + right * aPos.x + facing * aPos.y, layer);
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+    TexCoord = aTexCoord;
+}